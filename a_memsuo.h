@@ -28,233 +28,1589 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
-#ifdef USE_LIBSODIUM
+#include <stdarg.h>
+#include <stdio.h>
+/* USE_LIBSODIUM is the historical spelling; the Makefile and m_memsuo.h use USE_SODIUM. */
+#if defined(USE_LIBSODIUM) && !defined(USE_SODIUM)
+#define USE_SODIUM
+#endif
+#ifdef USE_SODIUM
 #include <sodium.h>
 #endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#include <sched.h>
+#include "s_memsuo.h"
+#define ARENA_HAVE_VM 1
+#endif
+#include "n_memsuo.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "l_memsuo.h"
+
+#ifndef ARENA_VM_COMMIT_CHUNK
+#define ARENA_VM_COMMIT_CHUNK (64 * 1024)
+#endif
+/* Blocks this large come from calloc, which hands back fresh zero pages for free. */
+#ifndef ARENA_CALLOC_MIN
+#define ARENA_CALLOC_MIN (128 * 1024)
+#endif
+/* Zeroing at least this much uses non-temporal stores instead of memset. */
+#ifndef ARENA_STREAM_ZERO_MIN
+#define ARENA_STREAM_ZERO_MIN (1024 * 1024)
+#endif
+/* Defaults for ArenaGrowth; see arena_set_growth. 0 disables the limit. */
+#ifndef ARENA_GROWTH_PERCENT
+#define ARENA_GROWTH_PERCENT 200
+#endif
+#ifndef ARENA_MAX_BLOCK
+#define ARENA_MAX_BLOCK 0
+#endif
+#ifndef ARENA_LARGE_THRESHOLD
+#define ARENA_LARGE_THRESHOLD 0
+#endif
+/* Bytes of released NUMA blocks each node's cache keeps for reuse. */
+#ifndef ARENA_NODE_CACHE_MAX
+#define ARENA_NODE_CACHE_MAX (64 * 1024 * 1024)
+#endif
+
+/*
+ * Process-wide cache of freed heap blocks (ENABLE_ARENA_BLOCK_CACHE). Blocks
+ * are bucketed by the power of two below their capacity, with
+ * ARENA_BLOCK_CACHE_SLOTS slots per bucket; blocks above
+ * ARENA_BLOCK_CACHE_MAX_BLOCK are never cached and the cache as a whole holds
+ * at most ARENA_BLOCK_CACHE_MAX_BYTES unless arena_block_cache_set_limit
+ * says otherwise.
+ */
+#ifndef ARENA_BLOCK_CACHE_SLOTS
+#define ARENA_BLOCK_CACHE_SLOTS 8
+#endif
+#ifndef ARENA_BLOCK_CACHE_MAX_BLOCK
+#define ARENA_BLOCK_CACHE_MAX_BLOCK (64 * 1024 * 1024)
+#endif
+#ifndef ARENA_BLOCK_CACHE_MAX_BYTES
+#define ARENA_BLOCK_CACHE_MAX_BYTES (256 * 1024 * 1024)
+#endif
+#define ARENA_BLOCK_CACHE_BUCKETS 48
 
+/* ArenaBlock.node for blocks from malloc, calloc or the secure slab. */
+#define ARENA_BLOCK_HEAP (-1)
+/* ArenaBlock.node for mapped blocks interleaved across every node. */
+#define ARENA_BLOCK_INTERLEAVED MEM_NUMA_MAX_NODES
+
+/*
+ * Block header. Except in vm arenas it sits at the start of the block's own
+ * allocation, ARENA_BLOCK_HEADER bytes ahead of `base`, so creating or freeing
+ * a block is one allocator call.
+ */
 typedef struct ArenaBlock
 {
     struct ArenaBlock *next;
     size_t capacity;
     size_t used;
+    size_t touched; /* bytes past this offset have never been handed out and are zero */
+    int node;       /* NUMA node of a mapped block, or ARENA_BLOCK_HEAP / ARENA_BLOCK_INTERLEAVED */
     unsigned char *base;
 } ArenaBlock;
 
+#define ARENA_BLOCK_HEADER ((sizeof(ArenaBlock) + 15) & ~(size_t)15)
+
+/*
+ * How an arena sizes the blocks it chains in. Each new bump block is
+ * `percent` percent of the previous one (200 doubles, 100 keeps the size
+ * constant), never more than `max_block` bytes unless a single request needs
+ * it. Requests of `large_threshold` bytes or more, and requests that would
+ * not fit in a `max_block` block, get an exact-size side block of their own
+ * instead, so the bump block keeps its tail and the next block's size is not
+ * inflated by them.
+ */
+typedef struct ArenaGrowth
+{
+    unsigned percent;
+    size_t max_block;
+    size_t large_threshold;
+} ArenaGrowth;
+
+/*
+ * `current` is the block being bumped into and [ptr, end) is its free tail, so
+ * the allocation fast path never touches the block list. The `used` field of
+ * the current block is only written back when the arena moves off it.
+ *
+ * `clean` caches the current block's `touched` mark. Bytes at or above both
+ * `ptr` and `clean` are known to be zero, so a zeroing allocation only clears
+ * what lies below `clean`; the mark is raised to `ptr` whenever ptr moves back.
+ *
+ * A `vm` arena has exactly one block: a PROT_NONE reservation of `capacity`
+ * bytes whose read/write prefix ends at `end` and is extended on demand.
+ *
+ * With a `numa` policy other than MEM_NUMA_DEFAULT, new blocks are mapped
+ * directly and bound with mbind before their first touch: to `numa_node`,
+ * to the node of the thread that grows the arena, or interleaved. Released
+ * blocks go to a per-node cache that later arenas on the same node draw from.
+ *
+ * `large` lists side blocks, most recent first; they are released by
+ * rewinding past them, by reset and by destroy.
+ *
+ * The remaining counters feed arena_stats. `spilled` is the bytes handed out
+ * from blocks behind `current` and from side blocks, so the bytes in use are
+ * always `spilled` plus the current block's prefix. `high_water` is only
+ * brought up to date when usage is about to drop, on rewind, reset, shrinking
+ * realloc and destroy, which is enough to catch every peak.
+ *
+ * With a nonzero `trim_decay` (see arena_set_trim), each reset folds the
+ * cycle's peak usage, `cycle_peak`, into the decaying `trim_mark` and releases
+ * whatever the arena holds beyond it.
+ */
 typedef struct Arena
 {
     ArenaBlock *blocks;
+    ArenaBlock *current;
+    unsigned char *ptr;
+    unsigned char *end;
+    unsigned char *clean;
     int secure;
+    int vm;
+    MemNumaPolicy numa;
+    int numa_node;
+    ArenaGrowth growth;
+    ArenaBlock *large;
+    size_t spilled;
+    size_t padding;
+    size_t tail_waste;
+    size_t high_water;
+    size_t block_count;
+    size_t held;
+    unsigned trim_decay;
+    size_t cycle_peak;
+    size_t trim_mark;
+#ifdef ENABLE_ARENA_REGISTRY
+    const char *label;
+    struct Arena *reg_next;
+    struct Arena **reg_pprev;
+#endif
 } Arena;
 
+/*
+ * Snapshot returned by arena_stats. `padding` and `tail_waste` are totals
+ * since arena_init: bytes skipped to satisfy alignment, and bytes left unused
+ * at the end of a block when growth moved on to the next one. `capacity` is
+ * what the arena's bump and side blocks hold (the committed prefix for a vm
+ * arena) and `used` includes padding. `padding` is only counted with
+ * ARENA_TRACK_PADDING and reads 0 otherwise.
+ */
+typedef struct ArenaStats
+{
+    size_t blocks;
+    size_t capacity;
+    size_t used;
+    size_t padding;
+    size_t tail_waste;
+    size_t high_water;
+} ArenaStats;
+
+/*
+ * Bookkeeping the bump fast path only pays for when asked. ARENA_TRACK_PADDING
+ * counts alignment padding for arena_stats; the registry's summaries report
+ * it, so ENABLE_ARENA_REGISTRY turns it on. MEMLAT_TIME_ARENA_ALLOC times
+ * every arena_alloc under ENABLE_MEM_LATENCY; without it only arena_grow is
+ * timed, since two clock reads cost more than the bump itself.
+ */
+#if defined(ENABLE_ARENA_REGISTRY) && !defined(ARENA_TRACK_PADDING)
+#define ARENA_TRACK_PADDING
+#endif
+#ifdef ARENA_TRACK_PADDING
+#define __ARENA_NOTE_PADDING(arena, bytes) ((arena)->padding += (bytes))
+#else
+#define __ARENA_NOTE_PADDING(arena, bytes) ((void)0)
+#endif
+#ifdef MEMLAT_TIME_ARENA_ALLOC
+#define __ARENA_LAT_NOW() __MEMLAT_NOW()
+#define __ARENA_LAT_RECORD(start) __MEMLAT_RECORD(MEMLAT_ARENA_ALLOC, (start))
+#else
+#define __ARENA_LAT_NOW() ((uint64_t)0)
+#define __ARENA_LAT_RECORD(start) ((void)(start))
+#endif
+
+/*
+ * A position in an arena. Rewinding to it releases everything allocated after
+ * it was taken while keeping the blocks themselves for reuse.
+ */
+typedef struct ArenaMark
+{
+    ArenaBlock *block;
+    unsigned char *ptr;
+    ArenaBlock *large;
+    size_t spilled;
+} ArenaMark;
+
+/*
+ * Growable array whose storage lives in an arena. Growth goes through
+ * arena_realloc, so while the array is the most recent allocation it extends
+ * in place; otherwise the old storage is abandoned to the arena. ArenaStr is
+ * the same structure used as a NUL-terminated string builder.
+ */
+typedef struct ArenaArray
+{
+    Arena *arena;
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    size_t elem_size;
+    size_t elem_align;
+} ArenaArray;
+
+typedef ArenaArray ArenaStr;
+
+typedef struct ArenaScratch
+{
+    Arena *arena;
+    ArenaMark mark;
+} ArenaScratch;
+
 #define ARENA_NO_ZERO 1
 
+#if defined(__GNUC__) || defined(__clang__)
+#define ARENA_LIKELY(x) __builtin_expect(!!(x), 1)
+#define ARENA_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define ARENA_ALWAYS_INLINE __attribute__((always_inline)) inline
+#define ARENA_NOINLINE __attribute__((noinline))
+#else
+#define ARENA_LIKELY(x) (x)
+#define ARENA_UNLIKELY(x) (x)
+#define ARENA_ALWAYS_INLINE inline
+#define ARENA_NOINLINE
+#endif
+
 static void arena_destroy(Arena *arena);
-static void *arena_alloc(Arena *arena, size_t size, size_t align, size_t count, int flags);
+static ARENA_ALWAYS_INLINE void *arena_alloc(Arena *arena, size_t size, size_t align, size_t count, int flags);
 static int arena_grow(Arena *arena, size_t min_size);
+static void arena_block_free(Arena *arena, ArenaBlock *block);
 
 #define ARENA_INIT(arenaPtr, initial_size, secure_flag) (arena_init((arenaPtr), (initial_size), (secure_flag)))
 
+/* With the registry enabled, scoped arenas are registered under their call site. */
+#ifdef ENABLE_ARENA_REGISTRY
+#define __ARENA_STR2(x) #x
+#define __ARENA_STR(x) __ARENA_STR2(x)
+#define __ARENA_SCOPE_REGISTER(name) arena_register(&(name), __FILE__ ":" __ARENA_STR(__LINE__))
+#else
+#define __ARENA_SCOPE_REGISTER(name) ((void)0)
+#endif
+
 #if defined(__GNUC__) || defined(__clang__)
 #define ARENA_SCOPE(name, initial_size)                                                                                \
     __attribute__((cleanup(arena_destroy))) Arena name;                                                                \
-    arena_init(&(name), (initial_size), 0)
+    arena_init(&(name), (initial_size), 0);                                                                            \
+    __ARENA_SCOPE_REGISTER(name)
 #define ARENA_SCOPE_SECURE(name, initial_size)                                                                         \
     __attribute__((cleanup(arena_destroy))) Arena name;                                                                \
-    arena_init(&(name), (initial_size), 1)
+    arena_init(&(name), (initial_size), 1);                                                                            \
+    __ARENA_SCOPE_REGISTER(name)
+#define ARENA_SCRATCH_SCOPE(name, arenaPtr)                                                                            \
+    __attribute__((cleanup(arena_scratch_end))) ArenaScratch name = arena_scratch_begin(arenaPtr)
+#define ARENA_SCOPE_VM(name, reserve_size)                                                                             \
+    __attribute__((cleanup(arena_destroy))) Arena name;                                                                \
+    arena_init_vm(&(name), (reserve_size));                                                                            \
+    __ARENA_SCOPE_REGISTER(name)
+#define ARENA_SCOPE_NUMA(name, initial_size, policy, node)                                                             \
+    __attribute__((cleanup(arena_destroy))) Arena name;                                                                \
+    arena_init_numa(&(name), (initial_size), (policy), (node));                                                        \
+    __ARENA_SCOPE_REGISTER(name)
 #else
 #define ARENA_SCOPE(name, initial_size)                                                                                \
     Arena name;                                                                                                        \
-    arena_init(&(name), (initial_size), 0)
+    arena_init(&(name), (initial_size), 0);                                                                            \
+    __ARENA_SCOPE_REGISTER(name)
 #define ARENA_SCOPE_SECURE(name, initial_size)                                                                         \
     Arena name;                                                                                                        \
-    arena_init(&(name), (initial_size), 1)
+    arena_init(&(name), (initial_size), 1);                                                                            \
+    __ARENA_SCOPE_REGISTER(name)
+#define ARENA_SCRATCH_SCOPE(name, arenaPtr) ArenaScratch name = arena_scratch_begin(arenaPtr)
+#define ARENA_SCOPE_VM(name, reserve_size)                                                                             \
+    Arena name;                                                                                                        \
+    arena_init_vm(&(name), (reserve_size));                                                                            \
+    __ARENA_SCOPE_REGISTER(name)
+#define ARENA_SCOPE_NUMA(name, initial_size, policy, node)                                                             \
+    Arena name;                                                                                                        \
+    arena_init_numa(&(name), (initial_size), (policy), (node));                                                        \
+    __ARENA_SCOPE_REGISTER(name)
 #endif
 
+/*
+ * sizeof/_Alignof are constants here, so once arena_alloc is inlined the
+ * overflow check and alignment mask fold away and only the bounds compare and
+ * cursor add remain (plus zeroing, for ARENA_ALLOC), unless ARENA_TRACK_PADDING
+ * or MEMLAT_TIME_ARENA_ALLOC ask for more.
+ */
 #define ARENA_ALLOC(arenaPtr, Type, count) ((Type *)arena_alloc((arenaPtr), sizeof(Type), _Alignof(Type), (count), 0))
 #define ARENA_ALLOC_NOZERO(arenaPtr, Type, count)                                                                      \
     ((Type *)arena_alloc((arenaPtr), sizeof(Type), _Alignof(Type), (count), ARENA_NO_ZERO))
+#define ARENA_REALLOC(arenaPtr, ptr, Type, old_count, new_count)                                                       \
+    ((Type *)arena_realloc_n((arenaPtr), (ptr), sizeof(Type), (old_count), (new_count), _Alignof(Type), 0))
 
-static int arena_init(Arena *arena, size_t initial_size, int secure_flag)
+#define ARENA_ARRAY_INIT(arrPtr, arenaPtr, Type) (arena_array_init((arrPtr), (arenaPtr), sizeof(Type), _Alignof(Type)))
+/* Evaluates to 0, or -1 when the array cannot grow. Without GNU C the value is copied from a compound literal. */
+#if defined(__GNUC__) || defined(__clang__)
+#define ARENA_ARRAY_PUSH(arrPtr, Type, value)                                                                          \
+    (__extension__({                                                                                                   \
+        Type *_aslot = (Type *)arena_array_push(arrPtr);                                                               \
+        if (_aslot)                                                                                                    \
+            *_aslot = (value);                                                                                         \
+        _aslot != NULL ? 0 : -1;                                                                                       \
+    }))
+#else
+#define ARENA_ARRAY_PUSH(arrPtr, Type, value) (arena_array_push_copy((arrPtr), (Type[1]){(value)}))
+#endif
+#define ARENA_ARRAY_AT(arrPtr, Type, i) (((Type *)(arrPtr)->data)[(i)])
+#define ARENA_ARRAY_DATA(arrPtr, Type) ((Type *)(arrPtr)->data)
+
+#ifdef ENABLE_ARENA_BLOCK_CACHE
+/*
+ * Each slot is an atomic pointer: put claims an empty slot with a
+ * compare-and-swap and take empties one with an exchange, so the cache is
+ * lock-free and a block can never be handed out twice. The definition below
+ * is weak, so every translation unit shares one cache without having to
+ * define it; a program that defines it itself overrides it.
+ */
+typedef struct ArenaBlockCache
 {
-    arena->secure = secure_flag;
-    arena->blocks = NULL;
-    if (initial_size == 0)
-        return 0;
-#ifdef USE_LIBSODIUM
-    if (arena->secure)
+    ArenaBlock *slots[ARENA_BLOCK_CACHE_BUCKETS][ARENA_BLOCK_CACHE_SLOTS];
+    size_t bytes;
+    size_t max_bytes; /* 0 selects ARENA_BLOCK_CACHE_MAX_BYTES */
+} ArenaBlockCache;
+
+__attribute__((weak)) ArenaBlockCache g_arena_block_cache;
+
+static inline size_t arena_block_cache_limit(void)
+{
+    size_t limit = __atomic_load_n(&g_arena_block_cache.max_bytes, __ATOMIC_RELAXED);
+    return limit ? limit : ARENA_BLOCK_CACHE_MAX_BYTES;
+}
+
+/*
+ * Takes a block of at least `capacity` bytes and less than four times that,
+ * or returns NULL. Only the bucket of the power of two at or above `capacity`
+ * is searched: its blocks are below twice that power, which is itself below
+ * twice `capacity`. The next bucket up could hand out nearly eight times.
+ */
+static inline ArenaBlock *arena_block_cache_take(size_t capacity)
+{
+    if (capacity == 0 || capacity > ARENA_BLOCK_CACHE_MAX_BLOCK)
+        return NULL;
+    int bucket = capacity == 1 ? 0 : 64 - __builtin_clzll((unsigned long long)(capacity - 1));
+    if (bucket >= ARENA_BLOCK_CACHE_BUCKETS)
+        return NULL;
+    ArenaBlock **slots = g_arena_block_cache.slots[bucket];
+    for (int i = 0; i < ARENA_BLOCK_CACHE_SLOTS; i++)
     {
-        if (sodium_init() < 0)
-            return -1;
-        unsigned char *ptr = (unsigned char *)sodium_malloc(initial_size);
-        if (!ptr)
-            return -1;
-        ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock));
-        if (!block)
+        if (!__atomic_load_n(&slots[i], __ATOMIC_RELAXED))
+            continue;
+        ArenaBlock *block = __atomic_exchange_n(&slots[i], NULL, __ATOMIC_ACQUIRE);
+        if (block)
         {
-            sodium_free(ptr);
-            return -1;
+            __atomic_sub_fetch(&g_arena_block_cache.bytes, ARENA_BLOCK_HEADER + block->capacity, __ATOMIC_RELAXED);
+            block->next = NULL;
+            block->used = 0;
+            return block;
         }
+    }
+    return NULL;
+}
+
+/* Caches a heap block; returns -1 when it is too large or the cache is full. */
+static inline int arena_block_cache_put(ArenaBlock *block)
+{
+    size_t capacity = block->capacity;
+    if (capacity > ARENA_BLOCK_CACHE_MAX_BLOCK)
+        return -1;
+    size_t total = ARENA_BLOCK_HEADER + capacity;
+    if (__atomic_add_fetch(&g_arena_block_cache.bytes, total, __ATOMIC_RELAXED) > arena_block_cache_limit())
+    {
+        __atomic_sub_fetch(&g_arena_block_cache.bytes, total, __ATOMIC_RELAXED);
+        return -1;
+    }
+    ArenaBlock **slots = g_arena_block_cache.slots[63 - __builtin_clzll((unsigned long long)capacity)];
+    for (int i = 0; i < ARENA_BLOCK_CACHE_SLOTS; i++)
+    {
+        ArenaBlock *expected = NULL;
+        if (!__atomic_load_n(&slots[i], __ATOMIC_RELAXED) &&
+            __atomic_compare_exchange_n(&slots[i], &expected, block, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return 0;
+    }
+    __atomic_sub_fetch(&g_arena_block_cache.bytes, total, __ATOMIC_RELAXED);
+    return -1;
+}
+
+/* Frees cached blocks, largest buckets first, until at most `keep_bytes` remain. */
+static inline void arena_block_cache_trim(size_t keep_bytes)
+{
+    for (int b = ARENA_BLOCK_CACHE_BUCKETS - 1; b >= 0; b--)
+    {
+        for (int i = 0; i < ARENA_BLOCK_CACHE_SLOTS; i++)
+        {
+            if (__atomic_load_n(&g_arena_block_cache.bytes, __ATOMIC_RELAXED) <= keep_bytes)
+                return;
+            ArenaBlock *block = __atomic_exchange_n(&g_arena_block_cache.slots[b][i], NULL, __ATOMIC_ACQUIRE);
+            if (!block)
+                continue;
+            __atomic_sub_fetch(&g_arena_block_cache.bytes, ARENA_BLOCK_HEADER + block->capacity, __ATOMIC_RELAXED);
+            free(block);
+        }
+    }
+}
+
+/* Changes the byte cap (0 restores the default) and trims down to it. */
+static inline void arena_block_cache_set_limit(size_t max_bytes)
+{
+    __atomic_store_n(&g_arena_block_cache.max_bytes, max_bytes, __ATOMIC_RELAXED);
+    arena_block_cache_trim(arena_block_cache_limit());
+}
+#endif
+
+#ifdef ARENA_HAVE_VM
+/*
+ * Released NUMA blocks, one list per node plus one for interleaved blocks.
+ * Like the block cache, the definition below is weak, so every translation
+ * unit shares one cache without having to define it.
+ */
+typedef struct ArenaNodeCache
+{
+    int lock;
+    ArenaBlock *blocks[MEM_NUMA_MAX_NODES + 1];
+    size_t bytes[MEM_NUMA_MAX_NODES + 1];
+} ArenaNodeCache;
+
+__attribute__((weak)) ArenaNodeCache __arena_node_cache;
+
+static inline void arena_node_cache_lock(void)
+{
+    while (__atomic_exchange_n(&__arena_node_cache.lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&__arena_node_cache.lock, __ATOMIC_RELAXED))
+            sched_yield();
+    }
+}
+
+static inline void arena_node_cache_unlock(void)
+{
+    __atomic_store_n(&__arena_node_cache.lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Takes the smallest cached block for `node` that fits `capacity` and is less than four times its size. */
+static ArenaBlock *arena_node_cache_take(int node, size_t capacity)
+{
+    arena_node_cache_lock();
+    ArenaBlock **best = NULL;
+    for (ArenaBlock **link = &__arena_node_cache.blocks[node]; *link; link = &(*link)->next)
+    {
+        size_t cap = (*link)->capacity;
+        if (cap >= capacity && cap / 4 < capacity && (!best || cap < (*best)->capacity))
+            best = link;
+    }
+    ArenaBlock *block = NULL;
+    if (best)
+    {
+        block = *best;
+        *best = block->next;
+        __arena_node_cache.bytes[node] -= block->capacity;
+    }
+    arena_node_cache_unlock();
+    if (block)
+    {
         block->next = NULL;
-        block->capacity = initial_size;
         block->used = 0;
-        block->base = ptr;
-        arena->blocks = block;
     }
+    return block;
+}
+
+/* Caches a mapped block for its node, or unmaps it once the cache is full. */
+static void arena_node_cache_put(ArenaBlock *block)
+{
+    int node = block->node;
+    arena_node_cache_lock();
+    if (__arena_node_cache.bytes[node] + block->capacity <= ARENA_NODE_CACHE_MAX)
+    {
+        block->next = __arena_node_cache.blocks[node];
+        __arena_node_cache.blocks[node] = block;
+        __arena_node_cache.bytes[node] += block->capacity;
+        block = NULL;
+    }
+    arena_node_cache_unlock();
+    if (block)
+        munmap(block, ARENA_BLOCK_HEADER + block->capacity);
+}
+
+/* Unmaps every block held by the node cache. */
+static inline void arena_node_cache_trim(void)
+{
+    for (int node = 0; node <= MEM_NUMA_MAX_NODES; node++)
+    {
+        arena_node_cache_lock();
+        ArenaBlock *block = __arena_node_cache.blocks[node];
+        __arena_node_cache.blocks[node] = NULL;
+        __arena_node_cache.bytes[node] = 0;
+        arena_node_cache_unlock();
+        while (block)
+        {
+            ArenaBlock *next = block->next;
+            munmap(block, ARENA_BLOCK_HEADER + block->capacity);
+            block = next;
+        }
+    }
+}
+
+/*
+ * Maps a block for a NUMA arena, rounded up to whole pages so mbind covers
+ * nothing but the block, and sets its policy before the first touch. Mapped
+ * pages arrive zeroed.
+ */
+static ArenaBlock *arena_block_new_numa(Arena *arena, size_t capacity)
+{
+    int node = ARENA_BLOCK_INTERLEAVED;
+    if (arena->numa == MEM_NUMA_BIND)
+        node = arena->numa_node;
+    else if (arena->numa == MEM_NUMA_LOCAL)
+        node = mem_numa_current_node();
+    if (node != ARENA_BLOCK_INTERLEAVED && (node < 0 || node >= mem_numa_node_count()))
+        node = 0;
+    ArenaBlock *block = arena_node_cache_take(node, capacity);
+    if (block)
+        return block;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (capacity > SIZE_MAX - page - ARENA_BLOCK_HEADER)
+        return NULL;
+    size_t len = (ARENA_BLOCK_HEADER + capacity + page - 1) / page * page;
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+    /* Placement is best effort; a kernel without NUMA support still gets a usable block. */
+    mem_numa_apply(map, len, arena->numa, node);
+    block = (ArenaBlock *)map;
+    block->next = NULL;
+    block->capacity = len - ARENA_BLOCK_HEADER;
+    block->used = 0;
+    block->touched = 0;
+    block->node = node;
+    block->base = (unsigned char *)map + ARENA_BLOCK_HEADER;
+    return block;
+}
+#endif
+
+/*
+ * Secure arenas take their blocks from the secure slab: locked, guarded,
+ * excluded from core dumps and wiped on release. Platforms without mmap fall
+ * back to sodium_malloc when libsodium is available. Other blocks come from
+ * the block cache when it is enabled and has one that fits.
+ */
+static ArenaBlock *arena_block_new(Arena *arena, size_t capacity)
+{
+    if (capacity > SIZE_MAX - ARENA_BLOCK_HEADER)
+        return NULL;
+    size_t total = ARENA_BLOCK_HEADER + capacity;
+    size_t touched = capacity;
+    ArenaBlock *block;
+#ifdef ARENA_HAVE_VM
+    if (arena->numa != MEM_NUMA_DEFAULT && !arena->secure)
+        return arena_block_new_numa(arena, capacity);
+    if (arena->secure)
+    {
+        /* Grow into the whole slot the slab rounds the request up to. */
+        capacity = secure_slab_usable(total) - ARENA_BLOCK_HEADER;
+        total = ARENA_BLOCK_HEADER + capacity;
+        block = (ArenaBlock *)secure_slab_alloc(&__secure_slab_default, total);
+        touched = 0;
+    }
+    else
+#elif defined(USE_SODIUM)
+    if (arena->secure)
+        block = (ArenaBlock *)sodium_malloc(total);
     else
 #endif
     {
-        unsigned char *ptr = (unsigned char *)malloc(initial_size);
-        if (!ptr)
-            return -1;
-        ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock));
-        if (!block)
+#ifdef ENABLE_ARENA_BLOCK_CACHE
+        block = arena_block_cache_take(capacity);
+        if (block)
+            return block;
+#endif
+        if (capacity >= ARENA_CALLOC_MIN)
         {
-            free(ptr);
-            return -1;
+            block = (ArenaBlock *)calloc(1, total);
+            touched = 0;
         }
-        block->next = NULL;
-        block->capacity = initial_size;
-        block->used = 0;
-        block->base = ptr;
-        arena->blocks = block;
+        else
+        {
+            block = (ArenaBlock *)malloc(total);
+        }
+    }
+    if (!block)
+        return NULL;
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    block->touched = touched;
+    block->node = ARENA_BLOCK_HEAP;
+    block->base = (unsigned char *)block + ARENA_BLOCK_HEADER;
+    return block;
+}
+
+/* Raises the current block's touched mark to the bump pointer before it moves back. */
+static ARENA_ALWAYS_INLINE void arena_note_touched(Arena *arena)
+{
+    if (arena->ptr > arena->clean)
+        arena->clean = arena->ptr;
+}
+
+/* Bytes handed out since the last reset, padding included. */
+static inline size_t arena_used(const Arena *arena)
+{
+    return arena->spilled + (arena->current ? (size_t)(arena->ptr - arena->current->base) : 0);
+}
+
+/* Raises the high-water marks to current usage before usage drops. */
+static inline void arena_note_high_water(Arena *arena)
+{
+    size_t used = arena_used(arena);
+    if (used > arena->high_water)
+        arena->high_water = used;
+    if (used > arena->cycle_peak)
+        arena->cycle_peak = used;
+}
+
+/*
+ * Writes the cursor and touched mark back into the current block. Needed
+ * before the block leaves the arena, since a recycled block trusts `touched`.
+ */
+static inline void arena_store_current(Arena *arena)
+{
+    if (arena->current)
+    {
+        arena_note_touched(arena);
+        arena->current->used = (size_t)(arena->ptr - arena->current->base);
+        arena->current->touched = (size_t)(arena->clean - arena->current->base);
     }
+}
+
+static void arena_set_current(Arena *arena, ArenaBlock *block)
+{
+    arena_store_current(arena);
+    arena->current = block;
+    arena->ptr = block->base + block->used;
+    arena->end = block->base + block->capacity;
+    arena->clean = block->base + block->touched;
+}
+
+static int arena_init(Arena *arena, size_t initial_size, int secure_flag)
+{
+    arena->secure = secure_flag;
+    arena->vm = 0;
+    arena->numa = MEM_NUMA_DEFAULT;
+    arena->numa_node = 0;
+    arena->growth.percent = ARENA_GROWTH_PERCENT;
+    arena->growth.max_block = ARENA_MAX_BLOCK;
+    arena->growth.large_threshold = ARENA_LARGE_THRESHOLD;
+    arena->large = NULL;
+    arena->blocks = NULL;
+    arena->current = NULL;
+    arena->ptr = NULL;
+    arena->end = NULL;
+    arena->clean = NULL;
+    arena->spilled = 0;
+    arena->padding = 0;
+    arena->tail_waste = 0;
+    arena->high_water = 0;
+    arena->block_count = 0;
+    arena->held = 0;
+    arena->trim_decay = 0;
+    arena->cycle_peak = 0;
+    arena->trim_mark = 0;
+#ifdef ENABLE_ARENA_REGISTRY
+    arena->label = NULL;
+    arena->reg_next = NULL;
+    arena->reg_pprev = NULL;
+#endif
+    if (initial_size == 0)
+        return 0;
+#ifdef USE_SODIUM
+    if (arena->secure && sodium_init() < 0)
+        return -1;
+#endif
+    ArenaBlock *block = arena_block_new(arena, initial_size);
+    if (!block)
+        return -1;
+    arena->blocks = block;
+    arena->block_count = 1;
+    arena->held = block->capacity;
+    arena_set_current(arena, block);
     return 0;
 }
 
-static void *arena_alloc(Arena *arena, size_t size, size_t align, size_t count, int flags)
+/*
+ * Reserves `reserve_size` bytes of address space without backing it. Pages
+ * are committed ARENA_VM_COMMIT_CHUNK at a time as the bump pointer reaches
+ * them, so the arena stays one contiguous region and never chains blocks.
+ * Allocations fail once the reservation is exhausted.
+ */
+static inline int arena_init_vm(Arena *arena, size_t reserve_size)
+{
+    arena_init(arena, 0, 0);
+#ifdef ARENA_HAVE_VM
+    size_t chunk = ARENA_VM_COMMIT_CHUNK;
+    if (reserve_size == 0 || reserve_size > SIZE_MAX - chunk)
+        return -1;
+    reserve_size = (reserve_size + chunk - 1) / chunk * chunk;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    void *base = mmap(NULL, reserve_size, PROT_NONE, flags, -1, 0);
+    if (base == MAP_FAILED)
+        return -1;
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock));
+    if (!block)
+    {
+        munmap(base, reserve_size);
+        return -1;
+    }
+    block->next = NULL;
+    block->capacity = reserve_size;
+    block->used = 0;
+    block->touched = 0;
+    block->node = ARENA_BLOCK_HEAP;
+    block->base = (unsigned char *)base;
+    arena->vm = 1;
+    arena->blocks = block;
+    arena->block_count = 1;
+    arena->current = block;
+    arena->ptr = block->base;
+    arena->end = block->base;
+    arena->clean = block->base;
+    return 0;
+#else
+    (void)reserve_size;
+    return -1;
+#endif
+}
+
+/*
+ * Sets the NUMA policy for blocks the arena creates from now on; blocks it
+ * already holds stay where they are. A vm arena applies the policy to its
+ * whole reservation at once, which places every page not yet touched.
+ * Secure arenas keep taking their blocks from the secure slab.
+ */
+static inline int arena_set_numa(Arena *arena, MemNumaPolicy policy, int node)
+{
+    arena->numa = policy;
+    arena->numa_node = node;
+#ifdef ARENA_HAVE_VM
+    if (arena->vm)
+    {
+        int target = policy == MEM_NUMA_LOCAL ? mem_numa_current_node() : node;
+        return mem_numa_apply(arena->current->base, arena->current->capacity, policy, target);
+    }
+#endif
+    return 0;
+}
+
+static inline int arena_init_numa(Arena *arena, size_t initial_size, MemNumaPolicy policy, int node)
+{
+    arena_init(arena, 0, 0);
+    arena_set_numa(arena, policy, node);
+    if (initial_size == 0)
+        return 0;
+    ArenaBlock *block = arena_block_new(arena, initial_size);
+    if (!block)
+        return -1;
+    arena->blocks = block;
+    arena->block_count = 1;
+    arena->held = block->capacity;
+    arena_set_current(arena, block);
+    return 0;
+}
+
+/* Extends the committed prefix of a vm arena so `min_size` bytes fit at ptr. */
+static inline int arena_vm_commit(Arena *arena, size_t min_size)
+{
+#ifdef ARENA_HAVE_VM
+    ArenaBlock *block = arena->current;
+    unsigned char *limit = block->base + block->capacity;
+    if (min_size > (size_t)(limit - arena->ptr))
+        return -1;
+    size_t target = (size_t)(arena->ptr - block->base) + min_size;
+    size_t chunk = ARENA_VM_COMMIT_CHUNK;
+    target = (target + chunk - 1) / chunk * chunk;
+    unsigned char *new_end = block->base + target;
+    if (mprotect(arena->end, (size_t)(new_end - arena->end), PROT_READ | PROT_WRITE) != 0)
+        return -1;
+    arena->end = new_end;
+    arena->held = target;
+    return 0;
+#else
+    (void)arena;
+    (void)min_size;
+    return -1;
+#endif
+}
+
+/*
+ * Hands the pages a vm arena has handed out back to the kernel, which refills
+ * them with zeros on the next touch. The first `keep` bytes, rounded up to a
+ * page, stay resident.
+ */
+static inline void arena_vm_release(Arena *arena, size_t keep)
+{
+#ifdef ARENA_HAVE_VM
+    ArenaBlock *block = arena->current;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    arena_note_touched(arena);
+    size_t len = ((size_t)(arena->clean - block->base) + page - 1) / page * page;
+    keep = keep < len ? (keep + page - 1) / page * page : len;
+    if (len > keep && madvise(block->base + keep, len - keep, MADV_DONTNEED) == 0)
+        arena->clean = block->base + keep;
+#else
+    (void)arena;
+    (void)keep;
+#endif
+}
+
+/*
+ * Large clears use non-temporal stores so a multi-megabyte zeroed buffer does
+ * not evict the caller's working set on its way to memory.
+ */
+static inline void arena_zero(void *ptr, size_t len)
+{
+#if defined(__SSE2__)
+    if (len >= ARENA_STREAM_ZERO_MIN)
+    {
+        unsigned char *p = (unsigned char *)ptr;
+        size_t head = (size_t)(-(uintptr_t)p & 15);
+        memset(p, 0, head);
+        p += head;
+        len -= head;
+        size_t body = len & ~(size_t)63;
+        __m128i zero = _mm_setzero_si128();
+        for (size_t i = 0; i < body; i += 64)
+        {
+            _mm_stream_si128((__m128i *)(p + i), zero);
+            _mm_stream_si128((__m128i *)(p + i + 16), zero);
+            _mm_stream_si128((__m128i *)(p + i + 32), zero);
+            _mm_stream_si128((__m128i *)(p + i + 48), zero);
+        }
+        _mm_sfence();
+        memset(p + body, 0, len - body);
+        return;
+    }
+#endif
+    memset(ptr, 0, len);
+}
+
+/* Zeroes the part of [p, p + len) that lies below the current block's touched mark. */
+static ARENA_ALWAYS_INLINE void arena_zero_dirty(const Arena *arena, unsigned char *p, size_t len)
+{
+    if (ARENA_UNLIKELY(p < arena->clean))
+    {
+        size_t dirty = (size_t)(arena->clean - p);
+        arena_zero(p, dirty < len ? dirty : len);
+    }
+}
+
+/*
+ * Replaces the growth policy for blocks chained in from now on. A percent
+ * below 100 is treated as 100.
+ */
+static inline void arena_set_growth(Arena *arena, unsigned percent, size_t max_block, size_t large_threshold)
+{
+    arena->growth.percent = percent < 100 ? 100 : percent;
+    arena->growth.max_block = max_block;
+    arena->growth.large_threshold = large_threshold;
+}
+
+/* Gives one request its own block, linked on `large`, without touching the bump block. */
+static void *arena_alloc_side(Arena *arena, size_t need, size_t total, size_t align, int flags)
+{
+    uint64_t lt = __MEMLAT_NOW();
+    ArenaBlock *block = arena_block_new(arena, need);
+    __MEMLAT_RECORD(MEMLAT_ARENA_GROW, lt);
+    if (!block)
+        return NULL;
+    block->next = arena->large;
+    arena->large = block;
+    arena->block_count++;
+    arena->held += block->capacity;
+    uintptr_t p = ((uintptr_t)block->base + (align - 1)) & ~(uintptr_t)(align - 1);
+    block->used = (size_t)(p - (uintptr_t)block->base) + total;
+    __ARENA_NOTE_PADDING(arena, block->used - total);
+    arena->spilled += block->used;
+    if (!(flags & ARENA_NO_ZERO) && block->touched)
+        arena_zero((void *)p, total);
+    if (block->touched < block->used)
+        block->touched = block->used;
+    return (void *)p;
+}
+
+/* Frees side blocks newer than `keep`. */
+static void arena_release_large(Arena *arena, ArenaBlock *keep)
+{
+    while (arena->large && arena->large != keep)
+    {
+        ArenaBlock *block = arena->large;
+        arena->large = block->next;
+        arena->block_count--;
+        arena->held -= block->capacity;
+        arena_block_free(arena, block);
+    }
+}
+
+static ARENA_NOINLINE void *arena_alloc_slow(Arena *arena, size_t total, size_t align, int flags)
+{
+    size_t need = total + (align - 1);
+    if (need < total)
+        return NULL;
+    const ArenaGrowth *g = &arena->growth;
+    if (!arena->vm && ((g->large_threshold && total >= g->large_threshold) || (g->max_block && need > g->max_block)))
+        return arena_alloc_side(arena, need, total, align, flags);
+    if (arena_grow(arena, need) != 0)
+        return NULL;
+    uintptr_t p = ((uintptr_t)arena->ptr + (align - 1)) & ~(uintptr_t)(align - 1);
+    __ARENA_NOTE_PADDING(arena, p - (uintptr_t)arena->ptr);
+    arena->ptr = (unsigned char *)(p + total);
+    if (!(flags & ARENA_NO_ZERO))
+        arena_zero_dirty(arena, (unsigned char *)p, total);
+    return (void *)p;
+}
+
+static ARENA_ALWAYS_INLINE void *arena_alloc(Arena *arena, size_t size, size_t align, size_t count, int flags)
 {
     if (count == 0 || size == 0)
         return NULL;
-    size_t total = size * count;
     if (count > SIZE_MAX / size)
         return NULL;
-    ArenaBlock *block = arena->blocks;
-    if (!block)
+    size_t total = size * count;
+    uint64_t lt = __ARENA_LAT_NOW();
+    uintptr_t p = ((uintptr_t)arena->ptr + (align - 1)) & ~(uintptr_t)(align - 1);
+    uintptr_t end = (uintptr_t)arena->end;
+    if (ARENA_UNLIKELY(p > end || total > end - p))
     {
-        if (arena_grow(arena, total) != 0)
-            return NULL;
-        block = arena->blocks;
+        void *slow = arena_alloc_slow(arena, total, align, flags);
+        __ARENA_LAT_RECORD(lt);
+        return slow;
     }
-    else
+    __ARENA_NOTE_PADDING(arena, p - (uintptr_t)arena->ptr);
+    arena->ptr = (unsigned char *)(p + total);
+    if (!(flags & ARENA_NO_ZERO))
+        arena_zero_dirty(arena, (unsigned char *)p, total);
+    __ARENA_LAT_RECORD(lt);
+    return (void *)p;
+}
+
+/* Counts the current block's prefix as spilled and its free tail as wasted. */
+static inline void arena_leave_current(Arena *arena)
+{
+    if (arena->current)
     {
-        while (block->next)
-            block = block->next;
+        arena->spilled += (size_t)(arena->ptr - arena->current->base);
+        arena->tail_waste += (size_t)(arena->end - arena->ptr);
     }
-    uintptr_t base_addr = (uintptr_t)block->base;
-    uintptr_t curr_ptr = base_addr + block->used;
-    size_t padding = 0;
-    if ((curr_ptr & (align - 1)) != 0)
-        padding = (align - (curr_ptr & (align - 1))) & (align - 1);
-    if (block->used + padding + total > block->capacity)
-    {
-        if (arena_grow(arena, total) != 0)
-            return NULL;
-        block = arena->blocks;
-        while (block->next)
-            block = block->next;
-        base_addr = (uintptr_t)block->base;
-        curr_ptr = base_addr + block->used;
-        padding = 0;
-        if ((curr_ptr & (align - 1)) != 0)
-            padding = (align - (curr_ptr & (align - 1))) & (align - 1);
-    }
-    curr_ptr += padding;
-    void *out_ptr = (void *)curr_ptr;
-    block->used += padding + total;
-    if (!(flags & ARENA_NO_ZERO))
-        memset(out_ptr, 0, total);
-    return out_ptr;
 }
 
-static int arena_grow(Arena *arena, size_t min_size)
+/*
+ * Blocks after `current` are retained from an earlier rewind or reset and are
+ * empty. Growing moves into the next one when it is large enough, otherwise a
+ * fresh block is linked in ahead of it.
+ */
+static int arena_next_block(Arena *arena, size_t min_size)
 {
-    size_t new_cap;
-    if (arena->blocks)
+    ArenaBlock *next = arena->current ? arena->current->next : arena->blocks;
+    if (next && next->capacity >= min_size)
+    {
+        next->used = 0;
+        arena_leave_current(arena);
+        arena_set_current(arena, next);
+        return 0;
+    }
+    size_t new_cap = min_size;
+    if (arena->current)
     {
-        ArenaBlock *last = arena->blocks;
-        while (last->next)
-            last = last->next;
-        new_cap = last->capacity * 2;
+        size_t cap = arena->current->capacity;
+        unsigned percent = arena->growth.percent;
+        new_cap = cap <= SIZE_MAX / percent ? cap / 100 * percent + cap % 100 * percent / 100 : SIZE_MAX;
+        if (arena->growth.max_block && new_cap > arena->growth.max_block)
+            new_cap = arena->growth.max_block;
         if (new_cap < min_size)
             new_cap = min_size;
     }
+    ArenaBlock *block = arena_block_new(arena, new_cap);
+    if (!block)
+        return -1;
+    block->next = next;
+    if (arena->current)
+        arena->current->next = block;
     else
+        arena->blocks = block;
+    arena->block_count++;
+    arena->held += block->capacity;
+    arena_leave_current(arena);
+    arena_set_current(arena, block);
+    return 0;
+}
+
+static int arena_grow(Arena *arena, size_t min_size)
+{
+    uint64_t lt = __MEMLAT_NOW();
+    int rc = arena->vm ? arena_vm_commit(arena, min_size) : arena_next_block(arena, min_size);
+    __MEMLAT_RECORD(MEMLAT_ARENA_GROW, lt);
+    return rc;
+}
+
+/*
+ * Resizes an allocation of `old_size` bytes. When it is the most recent
+ * allocation it grows or shrinks in place by moving the bump cursor; otherwise
+ * a new region is allocated and the old bytes are copied and abandoned. Bytes
+ * past `old_size` are zeroed unless ARENA_NO_ZERO is set.
+ */
+static inline void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size, size_t align, int flags)
+{
+    if (!ptr || old_size == 0)
+        return arena_alloc(arena, new_size, align, 1, flags);
+    if (new_size == 0)
+        return NULL;
+    unsigned char *p = (unsigned char *)ptr;
+    if (p + old_size == arena->ptr)
     {
-        new_cap = min_size;
+        if (new_size <= old_size)
+        {
+            arena_note_high_water(arena);
+            arena_note_touched(arena);
+            arena->ptr = p + new_size;
+            return ptr;
+        }
+        size_t extra = new_size - old_size;
+        if (extra <= (size_t)(arena->end - arena->ptr) || (arena->vm && arena_vm_commit(arena, extra) == 0))
+        {
+            arena->ptr = p + new_size;
+            if (!(flags & ARENA_NO_ZERO))
+                arena_zero_dirty(arena, p + old_size, extra);
+            return ptr;
+        }
     }
-#ifdef USE_LIBSODIUM
-    if (arena->secure)
+    else if (new_size <= old_size)
     {
-        unsigned char *ptr = (unsigned char *)sodium_malloc(new_cap);
-        if (!ptr)
-            return -1;
-        ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock));
-        if (!block)
+        return ptr;
+    }
+    unsigned char *out = (unsigned char *)arena_alloc(arena, new_size, align, 1, ARENA_NO_ZERO);
+    if (!out)
+        return NULL;
+    memcpy(out, p, old_size < new_size ? old_size : new_size);
+    if (new_size > old_size && !(flags & ARENA_NO_ZERO))
+    {
+        /* A side block has its own touched mark, so clear its tail outright. */
+        if (out + new_size == arena->ptr)
+            arena_zero_dirty(arena, out + old_size, new_size - old_size);
+        else
+            arena_zero(out + old_size, new_size - old_size);
+    }
+    return out;
+}
+
+/* arena_realloc for `old_count` and `new_count` elements of `size` bytes; NULL if either byte count overflows. */
+static inline void *arena_realloc_n(Arena *arena, void *ptr, size_t size, size_t old_count, size_t new_count,
+                                    size_t align, int flags)
+{
+    if (size == 0 || old_count > SIZE_MAX / size || new_count > SIZE_MAX / size)
+        return NULL;
+    return arena_realloc(arena, ptr, size * old_count, size * new_count, align, flags);
+}
+
+static inline ArenaMark arena_mark(const Arena *arena)
+{
+    ArenaMark mark;
+    mark.block = arena->current;
+    mark.ptr = arena->ptr;
+    mark.large = arena->large;
+    mark.spilled = arena->spilled;
+    return mark;
+}
+
+static inline void arena_scrub(void *ptr, size_t len)
+{
+#ifdef ARENA_HAVE_VM
+    secure_memzero(ptr, len);
+#elif defined(USE_SODIUM)
+    sodium_memzero(ptr, len);
+#else
+    memset(ptr, 0, len);
+#endif
+}
+
+/*
+ * Secure arenas wipe the bytes being released, walking only the blocks that
+ * were actually bumped into since the mark; plain arenas just move the cursor.
+ */
+static inline void arena_rewind(Arena *arena, ArenaMark mark)
+{
+    arena_note_high_water(arena);
+    if (arena->secure && arena->current)
+    {
+        ArenaBlock *block = mark.block ? mark.block : arena->blocks;
+        unsigned char *from = mark.block ? mark.ptr : block->base;
+        for (;;)
         {
-            sodium_free(ptr);
-            return -1;
+            unsigned char *to = block == arena->current ? arena->ptr : block->base + block->used;
+            if (to > from)
+                arena_scrub(from, (size_t)(to - from));
+            if (block == arena->current)
+                break;
+            if (block != mark.block)
+                block->used = 0;
+            block = block->next;
+            from = block->base;
         }
-        block->next = NULL;
-        block->capacity = new_cap;
-        block->used = 0;
-        block->base = ptr;
-        if (!arena->blocks)
-            arena->blocks = block;
-        else
+    }
+    arena_release_large(arena, mark.large);
+    arena_note_touched(arena);
+    arena->ptr = mark.ptr;
+    arena->spilled = mark.spilled;
+    if (arena->vm || arena->current == mark.block)
+        return;
+    if (arena->current)
+        arena->current->touched = (size_t)(arena->clean - arena->current->base);
+    arena->current = mark.block;
+    arena->end = mark.block ? mark.block->base + mark.block->capacity : NULL;
+    arena->clean = mark.block ? mark.block->base + mark.block->touched : NULL;
+}
+
+static inline ArenaScratch arena_scratch_begin(Arena *arena)
+{
+    ArenaScratch scratch;
+    scratch.arena = arena;
+    scratch.mark = arena_mark(arena);
+    return scratch;
+}
+
+static inline void arena_scratch_end(ArenaScratch *scratch)
+{
+    arena_rewind(scratch->arena, scratch->mark);
+}
+
+/*
+ * Makes arena_reset adaptive. Each reset the trim mark becomes the larger of
+ * the cycle's peak usage and `decay_percent` percent of its previous value,
+ * and whatever the arena holds beyond the mark is released. 90 lets a spike
+ * fade over a few dozen resets; 0 turns trimming off, which is the default.
+ */
+static inline void arena_set_trim(Arena *arena, unsigned decay_percent)
+{
+    arena->trim_decay = decay_percent > 100 ? 100 : decay_percent;
+    arena->trim_mark = 0;
+    arena->cycle_peak = 0;
+}
+
+/* Folds the cycle that is ending into the trim mark and returns the new mark. */
+static inline size_t arena_trim_target(Arena *arena)
+{
+    size_t mark = arena->trim_mark;
+    unsigned decay = arena->trim_decay;
+    size_t keep = mark / 100 * decay + mark % 100 * decay / 100;
+    arena->trim_mark = arena->cycle_peak > keep ? arena->cycle_peak : keep;
+    return arena->trim_mark;
+}
+
+/*
+ * Frees blocks past the first until what is kept covers `target`. A block
+ * that would take the kept total past twice the target is freed even then, so
+ * one block grown for a spike does not stay pinned once usage falls back.
+ */
+static void arena_trim_blocks(Arena *arena, size_t target)
+{
+    size_t limit = target > SIZE_MAX / 2 ? SIZE_MAX : target * 2;
+    size_t kept = arena->blocks->capacity;
+    ArenaBlock **link = &arena->blocks->next;
+    while (*link)
+    {
+        ArenaBlock *block = *link;
+        if (kept < target && block->capacity <= limit - kept)
         {
-            ArenaBlock *last = arena->blocks;
-            while (last->next)
-                last = last->next;
-            last->next = block;
+            kept += block->capacity;
+            link = &block->next;
+            continue;
         }
+        *link = block->next;
+        arena->block_count--;
+        arena->held -= block->capacity;
+        arena_block_free(arena, block);
     }
-    else
+}
+
+/*
+ * Releases every allocation but keeps all grown blocks for the next cycle. A
+ * vm arena keeps its reservation and committed range but returns the touched
+ * pages to the kernel. With trimming enabled, only what lies beyond the trim
+ * mark is freed or returned, so the working set stays warm.
+ */
+static inline void arena_reset(Arena *arena)
+{
+    arena_note_high_water(arena);
+    size_t target = arena->trim_decay ? arena_trim_target(arena) : 0;
+    if (arena->vm)
+    {
+        arena_vm_release(arena, target);
+        arena->ptr = arena->current->base;
+        arena->cycle_peak = 0;
+        return;
+    }
+    ArenaMark mark;
+    mark.block = arena->blocks;
+    mark.ptr = arena->blocks ? arena->blocks->base : NULL;
+    mark.large = NULL;
+    mark.spilled = 0;
+    arena_rewind(arena, mark);
+    if (arena->trim_decay && arena->blocks)
+        arena_trim_blocks(arena, target);
+    arena->cycle_peak = 0;
+}
+
+static void arena_block_free(Arena *arena, ArenaBlock *block)
+{
+#ifdef ARENA_HAVE_VM
+    if (arena->vm)
+    {
+        munmap(block->base, block->capacity);
+        free(block);
+        return;
+    }
+    if (block->node != ARENA_BLOCK_HEAP)
+    {
+        arena_node_cache_put(block);
+        return;
+    }
+    if (arena->secure)
+    {
+        secure_slab_free(block);
+        return;
+    }
+#elif defined(USE_SODIUM)
+    if (arena->secure)
+    {
+        sodium_free(block);
+        return;
+    }
+#else
+    (void)arena;
+#endif
+#ifdef ENABLE_ARENA_BLOCK_CACHE
+    if (arena_block_cache_put(block) == 0)
+        return;
+#endif
+    free(block);
+}
+
+/*
+ * Fills `stats` from counters the arena keeps as it goes, so the query is
+ * O(1) and does not walk the block list.
+ */
+static inline void arena_stats(const Arena *arena, ArenaStats *stats)
+{
+    stats->blocks = arena->block_count;
+    stats->capacity = arena->held;
+    stats->used = arena_used(arena);
+    stats->padding = arena->padding;
+    stats->tail_waste = arena->tail_waste;
+    stats->high_water = arena->high_water > stats->used ? arena->high_water : stats->used;
+}
+
+/*
+ * Recomputes the block count and held capacity after blocks were moved in or
+ * out of the arena's lists directly, as the thread-local scratch pool does.
+ */
+static inline void arena_recount(Arena *arena)
+{
+    size_t count = 0, held = 0;
+    for (ArenaBlock *block = arena->blocks; block; block = block->next, count++)
+        held += block->capacity;
+    for (ArenaBlock *block = arena->large; block; block = block->next, count++)
+        held += block->capacity;
+    arena->block_count = count;
+    arena->held = held;
+}
+
+#ifdef ENABLE_ARENA_REGISTRY
+/*
+ * Live arenas that opted in with arena_register, plus a summary per label of
+ * the ones already destroyed. ARENA_SCOPE and its variants register under
+ * "file:line", so the summary shows what each call site needed over the life
+ * of the process. Registering and destroying take a global spinlock and scan
+ * the site labels, so with the registry on every scoped arena pays for both;
+ * it is meant for profiling builds. The allocation paths never touch it. Like
+ * the block cache, it is defined weakly here, so programs need not define it.
+ */
+#ifndef ARENA_REGISTRY_SITES
+#define ARENA_REGISTRY_SITES 64
 #endif
+
+typedef struct ArenaSiteStats
+{
+    const char *label;
+    size_t arenas;     /* destroyed arenas folded into this entry */
+    size_t blocks;     /* most blocks any of them held */
+    size_t capacity;   /* most capacity any of them held */
+    size_t high_water; /* highest usage any of them reached */
+    size_t padding;    /* summed over all of them */
+    size_t tail_waste; /* summed over all of them */
+} ArenaSiteStats;
+
+typedef struct ArenaRegistry
+{
+    int lock;
+    Arena *head;
+    size_t site_count;
+    ArenaSiteStats sites[ARENA_REGISTRY_SITES];
+} ArenaRegistry;
+
+__attribute__((weak)) ArenaRegistry g_arena_registry;
+
+static inline void arena_registry_lock(void)
+{
+    while (__atomic_exchange_n(&g_arena_registry.lock, 1, __ATOMIC_ACQUIRE))
     {
-        unsigned char *ptr = (unsigned char *)malloc(new_cap);
-        if (!ptr)
-            return -1;
-        ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock));
-        if (!block)
+        while (__atomic_load_n(&g_arena_registry.lock, __ATOMIC_RELAXED))
+            sched_yield();
+    }
+}
+
+static inline void arena_registry_unlock(void)
+{
+    __atomic_store_n(&g_arena_registry.lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Adds an initialized arena to the registry under `label`, which must outlive it. */
+static inline void arena_register(Arena *arena, const char *label)
+{
+    arena_registry_lock();
+    if (!arena->reg_pprev)
+    {
+        arena->label = label;
+        arena->reg_next = g_arena_registry.head;
+        if (arena->reg_next)
+            arena->reg_next->reg_pprev = &arena->reg_next;
+        arena->reg_pprev = &g_arena_registry.head;
+        g_arena_registry.head = arena;
+    }
+    arena_registry_unlock();
+}
+
+/*
+ * Removes the arena and folds its final numbers into its label's summary.
+ * arena_destroy calls this; a second call is a no-op.
+ */
+static inline void arena_unregister(Arena *arena)
+{
+    if (!arena->reg_pprev)
+        return;
+    ArenaStats stats;
+    arena_stats(arena, &stats);
+    arena_registry_lock();
+    *arena->reg_pprev = arena->reg_next;
+    if (arena->reg_next)
+        arena->reg_next->reg_pprev = arena->reg_pprev;
+    arena->reg_next = NULL;
+    arena->reg_pprev = NULL;
+    ArenaSiteStats *site = NULL;
+    if (arena->label)
+    {
+        for (size_t i = 0; i < g_arena_registry.site_count && !site; i++)
         {
-            free(ptr);
-            return -1;
+            const char *label = g_arena_registry.sites[i].label;
+            if (label == arena->label || strcmp(label, arena->label) == 0)
+                site = &g_arena_registry.sites[i];
         }
-        block->next = NULL;
-        block->capacity = new_cap;
-        block->used = 0;
-        block->base = ptr;
-        if (!arena->blocks)
-            arena->blocks = block;
-        else
+        if (!site && g_arena_registry.site_count < ARENA_REGISTRY_SITES)
         {
-            ArenaBlock *last = arena->blocks;
-            while (last->next)
-                last = last->next;
-            last->next = block;
+            site = &g_arena_registry.sites[g_arena_registry.site_count++];
+            memset(site, 0, sizeof(*site));
+            site->label = arena->label;
         }
     }
-    return 0;
+    if (site)
+    {
+        site->arenas++;
+        if (stats.blocks > site->blocks)
+            site->blocks = stats.blocks;
+        if (stats.capacity > site->capacity)
+            site->capacity = stats.capacity;
+        if (stats.high_water > site->high_water)
+            site->high_water = stats.high_water;
+        site->padding += stats.padding;
+        site->tail_waste += stats.tail_waste;
+    }
+    arena_registry_unlock();
 }
 
+/*
+ * Prints every live arena followed by the per-label summaries. Numbers for
+ * arenas another thread is allocating from are approximate.
+ */
+static inline void arena_registry_report(FILE *out)
+{
+    arena_registry_lock();
+    fprintf(out, "Arenas (bytes):\n");
+    fprintf(out, "  %-32s %8s %6s %12s %12s %12s %10s %10s\n", "label", "arenas", "blocks", "capacity", "used",
+            "high-water", "padding", "tail");
+    for (Arena *arena = g_arena_registry.head; arena; arena = arena->reg_next)
+    {
+        ArenaStats stats;
+        arena_stats(arena, &stats);
+        fprintf(out, "  %-32s %8s %6zu %12zu %12zu %12zu %10zu %10zu\n", arena->label ? arena->label : "(unlabeled)",
+                "live", stats.blocks, stats.capacity, stats.used, stats.high_water, stats.padding, stats.tail_waste);
+    }
+    for (size_t i = 0; i < g_arena_registry.site_count; i++)
+    {
+        const ArenaSiteStats *site = &g_arena_registry.sites[i];
+        fprintf(out, "  %-32s %8zu %6zu %12zu %12s %12zu %10zu %10zu\n", site->label, site->arenas, site->blocks,
+                site->capacity, "-", site->high_water, site->padding, site->tail_waste);
+    }
+    arena_registry_unlock();
+}
+
+/* Copies the summary recorded for `label`; returns -1 if there is none. */
+static inline int arena_registry_site(const char *label, ArenaSiteStats *out)
+{
+    int rc = -1;
+    arena_registry_lock();
+    for (size_t i = 0; i < g_arena_registry.site_count; i++)
+    {
+        if (strcmp(g_arena_registry.sites[i].label, label) == 0)
+        {
+            *out = g_arena_registry.sites[i];
+            rc = 0;
+            break;
+        }
+    }
+    arena_registry_unlock();
+    return rc;
+}
+#endif
+
 static void arena_destroy(Arena *arena)
 {
+    arena_note_high_water(arena);
+#ifdef ENABLE_ARENA_REGISTRY
+    arena_unregister(arena);
+#endif
+    arena_release_large(arena, NULL);
+    arena_store_current(arena);
     ArenaBlock *block = arena->blocks;
     while (block)
     {
         ArenaBlock *next = block->next;
-#ifdef USE_LIBSODIUM
-        if (arena->secure)
-            sodium_free(block->base);
-        else
-            free(block->base);
-#else
-        free(block->base);
-#endif
-        free(block);
+        arena_block_free(arena, block);
         block = next;
     }
     arena->blocks = NULL;
+    arena->current = NULL;
+    arena->ptr = NULL;
+    arena->end = NULL;
+    arena->clean = NULL;
+    arena->vm = 0;
+    arena->spilled = 0;
+    arena->block_count = 0;
+    arena->held = 0;
+}
+
+static inline void arena_array_init(ArenaArray *arr, Arena *arena, size_t elem_size, size_t elem_align)
+{
+    arr->arena = arena;
+    arr->data = NULL;
+    arr->len = 0;
+    arr->cap = 0;
+    arr->elem_size = elem_size;
+    arr->elem_align = elem_align;
+}
+
+/* Ensures room for `min_cap` elements, at least doubling the capacity. */
+static inline int arena_array_reserve(ArenaArray *arr, size_t min_cap)
+{
+    if (min_cap <= arr->cap)
+        return 0;
+    size_t new_cap = arr->cap ? arr->cap : 8;
+    while (new_cap < min_cap)
+    {
+        if (new_cap > SIZE_MAX / 2)
+            return -1;
+        new_cap *= 2;
+    }
+    if (new_cap > SIZE_MAX / arr->elem_size)
+        return -1;
+    void *data = arena_realloc(arr->arena, arr->data, arr->cap * arr->elem_size, new_cap * arr->elem_size,
+                               arr->elem_align, ARENA_NO_ZERO);
+    if (!data)
+        return -1;
+    arr->data = (unsigned char *)data;
+    arr->cap = new_cap;
+    return 0;
+}
+
+/* Appends one uninitialized element and returns it, or NULL on failure. */
+static inline void *arena_array_push(ArenaArray *arr)
+{
+    if (ARENA_UNLIKELY(arr->len == arr->cap) && arena_array_reserve(arr, arr->len + 1) != 0)
+        return NULL;
+    return arr->data + arr->elem_size * arr->len++;
+}
+
+/* Appends a copy of the element at `elem`; returns 0, or -1 on failure. */
+static inline int arena_array_push_copy(ArenaArray *arr, const void *elem)
+{
+    void *slot = arena_array_push(arr);
+    if (!slot)
+        return -1;
+    memcpy(slot, elem, arr->elem_size);
+    return 0;
+}
+
+static inline int arena_str_init(ArenaStr *str, Arena *arena)
+{
+    arena_array_init(str, arena, 1, 1);
+    if (arena_array_reserve(str, 1) != 0)
+        return -1;
+    str->data[0] = '\0';
+    return 0;
+}
+
+static inline int arena_str_append(ArenaStr *str, const char *s, size_t n)
+{
+    if (n > SIZE_MAX - str->len - 1 || arena_array_reserve(str, str->len + n + 1) != 0)
+        return -1;
+    memcpy(str->data + str->len, s, n);
+    str->len += n;
+    str->data[str->len] = '\0';
+    return 0;
+}
+
+static inline int arena_str_appendf(ArenaStr *str, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf((char *)str->data + str->len, str->cap - str->len, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+        return -1;
+    if ((size_t)n >= str->cap - str->len)
+    {
+        if (arena_array_reserve(str, str->len + (size_t)n + 1) != 0)
+            return -1;
+        va_start(ap, fmt);
+        vsnprintf((char *)str->data + str->len, str->cap - str->len, fmt, ap);
+        va_end(ap);
+    }
+    str->len += (size_t)n;
+    return 0;
+}
+
+static inline const char *arena_str_cstr(const ArenaStr *str)
+{
+    return (const char *)str->data;
 }
 
 #endif // A_MEMSUO_H
@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "m_memsuo.h"
+#include "a_memsuo.h"
+
+/*
+ * Allocator comparison harness. Every backend runs the same workload: each
+ * thread allocates a batch of BENCH_BATCH objects with sizes drawn from a
+ * distribution, writes the first byte of each, then frees the whole batch
+ * (arena backends rewind with arena_reset). A throughput pass reports
+ * alloc+free pairs per second; a separate latency pass times every alloc
+ * call, subtracts the clock's own overhead and reports percentiles.
+ *
+ * Output is CSV on stdout, one row per backend/distribution/thread count:
+ *   backend,dist,threads,ops,mops_per_sec,p50_ns,p99_ns,p999_ns,max_ns
+ *
+ * Usage: bench_alloc [max_threads] [ops_per_thread]
+ */
+
+#define BENCH_BATCH 1024
+#define BENCH_DEFAULT_OPS 2000000
+#define BENCH_MAX_THREADS 64
+#define BENCH_ARENA_BLOCK (1 << 20)
+
+typedef struct Worker Worker;
+
+typedef struct
+{
+    const char *name;
+    int slowdown; /* divides the op count for allocators that cost microseconds */
+    int (*setup)(Worker *w);
+    void *(*alloc)(Worker *w, size_t size);
+    void (*release)(Worker *w, void **ptrs, size_t n);
+    void (*teardown)(Worker *w);
+} Backend;
+
+typedef struct
+{
+    const char *name;
+    size_t (*next)(uint32_t *rng);
+} SizeDist;
+
+struct Worker
+{
+    const Backend *backend;
+    const SizeDist *dist;
+    Arena arena;
+    uint32_t rng;
+    size_t ops;
+    uint32_t *lat; /* per-alloc latency in ns, latency pass only */
+    uint64_t start, end;
+    void *ptrs[BENCH_BATCH];
+    size_t sizes[BENCH_BATCH];
+};
+
+static pthread_barrier_t g_start;
+static uint64_t g_clock_overhead;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t next_rand(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static size_t dist_fixed16(uint32_t *rng)
+{
+    (void)rng;
+    return 16;
+}
+
+static size_t dist_small(uint32_t *rng)
+{
+    return 8 + next_rand(rng) % 249;
+}
+
+/* 80% 8..256 bytes, 15% up to 4 KiB, 5% up to 64 KiB. */
+static size_t dist_mixed(uint32_t *rng)
+{
+    uint32_t r = next_rand(rng) % 100;
+    if (r < 80)
+        return 8 + next_rand(rng) % 249;
+    if (r < 95)
+        return 257 + next_rand(rng) % 3840;
+    return 4097 + next_rand(rng) % 61440;
+}
+
+static const SizeDist g_dists[] = {
+    {"fixed16", dist_fixed16},
+    {"small", dist_small},
+    {"mixed", dist_mixed},
+};
+
+static int setup_none(Worker *w)
+{
+    (void)w;
+    return 0;
+}
+
+static void teardown_none(Worker *w)
+{
+    (void)w;
+}
+
+static void *alloc_malloc_macro(Worker *w, size_t size)
+{
+    (void)w;
+    return MALLOC(size);
+}
+
+static void release_malloc_macro(Worker *w, void **ptrs, size_t n)
+{
+    (void)w;
+    for (size_t i = 0; i < n; i++)
+        FREE(ptrs[i]);
+}
+
+static void release_sized_free(Worker *w, void **ptrs, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        SIZED_FREE(ptrs[i], w->sizes[i]);
+}
+
+static void *alloc_libc(Worker *w, size_t size)
+{
+    (void)w;
+    return malloc(size);
+}
+
+static void release_libc(Worker *w, void **ptrs, size_t n)
+{
+    (void)w;
+    for (size_t i = 0; i < n; i++)
+        free(ptrs[i]);
+}
+
+static int setup_arena(Worker *w)
+{
+    return arena_init(&w->arena, BENCH_ARENA_BLOCK, 0);
+}
+
+static int setup_arena_secure(Worker *w)
+{
+    return arena_init(&w->arena, BENCH_ARENA_BLOCK, 1);
+}
+
+static void *alloc_arena(Worker *w, size_t size)
+{
+    return arena_alloc(&w->arena, size, 16, 1, ARENA_NO_ZERO);
+}
+
+static void release_arena(Worker *w, void **ptrs, size_t n)
+{
+    (void)ptrs;
+    (void)n;
+    arena_reset(&w->arena);
+}
+
+static void teardown_arena(Worker *w)
+{
+    arena_destroy(&w->arena);
+}
+
+static void *alloc_secure(Worker *w, size_t size)
+{
+    (void)w;
+    return secure_slab_alloc(&__secure_slab_default, size);
+}
+
+static void release_secure(Worker *w, void **ptrs, size_t n)
+{
+    (void)w;
+    for (size_t i = 0; i < n; i++)
+        SECURE_FREE(ptrs[i]);
+}
+
+#ifdef USE_SODIUM
+static void *alloc_sodium(Worker *w, size_t size)
+{
+    (void)w;
+    return SODIUM_MALLOC(size);
+}
+
+static void release_sodium(Worker *w, void **ptrs, size_t n)
+{
+    (void)w;
+    for (size_t i = 0; i < n; i++)
+        SODIUM_FREE(ptrs[i]);
+}
+#endif
+
+static const Backend g_backends[] = {
+#ifdef USE_JEMALLOC
+    {"MALLOC_jemalloc", 1, setup_none, alloc_malloc_macro, release_malloc_macro, teardown_none},
+#else
+    {"MALLOC_libc", 1, setup_none, alloc_malloc_macro, release_malloc_macro, teardown_none},
+#endif
+    {"MALLOC_sized_free", 1, setup_none, alloc_malloc_macro, release_sized_free, teardown_none},
+    {"libc_malloc", 1, setup_none, alloc_libc, release_libc, teardown_none},
+    {"arena_alloc", 1, setup_arena, alloc_arena, release_arena, teardown_arena},
+    {"arena_alloc_secure", 1, setup_arena_secure, alloc_arena, release_arena, teardown_arena},
+    {"SECURE_ALLOC", 16, setup_none, alloc_secure, release_secure, teardown_none},
+#ifdef USE_SODIUM
+    {"SODIUM_MALLOC", 256, setup_none, alloc_sodium, release_sodium, teardown_none},
+#endif
+};
+
+static void *run_worker(void *arg)
+{
+    Worker *w = (Worker *)arg;
+    const Backend *b = w->backend;
+    size_t done = 0;
+    pthread_barrier_wait(&g_start);
+    w->start = now_ns();
+    while (done < w->ops)
+    {
+        size_t n = w->ops - done < BENCH_BATCH ? w->ops - done : BENCH_BATCH;
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t size = w->dist->next(&w->rng);
+            unsigned char *p;
+            if (w->lat)
+            {
+                uint64_t t0 = now_ns();
+                p = (unsigned char *)b->alloc(w, size);
+                uint64_t dt = now_ns() - t0;
+                dt = dt > g_clock_overhead ? dt - g_clock_overhead : 0;
+                w->lat[done + i] = dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt;
+            }
+            else
+            {
+                p = (unsigned char *)b->alloc(w, size);
+            }
+            if (p)
+                p[0] = (unsigned char)i;
+            w->ptrs[i] = p;
+            w->sizes[i] = size;
+        }
+        b->release(w, w->ptrs, n);
+        done += n;
+    }
+    w->end = now_ns();
+    return NULL;
+}
+
+/*
+ * Runs one pass and returns the wall time from the first worker starting to
+ * the last one finishing, in ns, or 0 on failure. Workers stamp their own
+ * start so the result is right even when they run before the main thread
+ * wakes from the barrier.
+ */
+static uint64_t run_pass(const Backend *b, const SizeDist *d, int threads, size_t ops, Worker *workers, int timed)
+{
+    pthread_t tids[BENCH_MAX_THREADS];
+    for (int t = 0; t < threads; t++)
+    {
+        Worker *w = &workers[t];
+        w->backend = b;
+        w->dist = d;
+        w->rng = 2463534242u + (uint32_t)t * 7919u;
+        w->ops = ops;
+        w->lat = timed ? (uint32_t *)malloc(ops * sizeof(uint32_t)) : NULL;
+        if ((timed && !w->lat) || b->setup(w) != 0)
+            return 0;
+    }
+    pthread_barrier_init(&g_start, NULL, (unsigned)threads + 1);
+    for (int t = 0; t < threads; t++)
+        pthread_create(&tids[t], NULL, run_worker, &workers[t]);
+    pthread_barrier_wait(&g_start);
+    uint64_t first = UINT64_MAX, last = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(tids[t], NULL);
+        first = workers[t].start < first ? workers[t].start : first;
+        last = workers[t].end > last ? workers[t].end : last;
+    }
+    uint64_t elapsed = last - first;
+    pthread_barrier_destroy(&g_start);
+    for (int t = 0; t < threads; t++)
+        b->teardown(&workers[t]);
+    return elapsed ? elapsed : 1;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t measure_clock_overhead(void)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 10000; i++)
+    {
+        uint64_t t0 = now_ns();
+        uint64_t dt = now_ns() - t0;
+        if (dt < best)
+            best = dt;
+    }
+    return best;
+}
+
+static void bench_one(const Backend *b, const SizeDist *d, int threads, size_t ops, Worker *workers)
+{
+    ops /= (size_t)b->slowdown;
+    if (ops < BENCH_BATCH)
+        ops = BENCH_BATCH;
+
+    uint64_t elapsed = run_pass(b, d, threads, ops, workers, 0);
+    if (elapsed == 0)
+    {
+        fprintf(stderr, "%s: setup failed\n", b->name);
+        return;
+    }
+    double mops = (double)ops * threads / ((double)elapsed / 1e3);
+
+    size_t lat_ops = ops / 4 < BENCH_BATCH ? BENCH_BATCH : ops / 4;
+    size_t total = lat_ops * (size_t)threads;
+    uint32_t *all = (uint32_t *)malloc(total * sizeof(uint32_t));
+    if (!all || run_pass(b, d, threads, lat_ops, workers, 1) == 0)
+    {
+        fprintf(stderr, "%s: latency pass failed\n", b->name);
+        free(all);
+        for (int t = 0; t < threads; t++)
+        {
+            free(workers[t].lat);
+            workers[t].lat = NULL;
+        }
+        return;
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        memcpy(all + (size_t)t * lat_ops, workers[t].lat, lat_ops * sizeof(uint32_t));
+        free(workers[t].lat);
+        workers[t].lat = NULL;
+    }
+    qsort(all, total, sizeof(uint32_t), cmp_u32);
+    printf("%s,%s,%d,%zu,%.3f,%u,%u,%u,%u\n", b->name, d->name, threads, ops * (size_t)threads, mops,
+           all[total / 2], all[total - 1 - total / 100], all[total - 1 - total / 1000], all[total - 1]);
+    fflush(stdout);
+    free(all);
+}
+
+int main(int argc, char **argv)
+{
+    long max_threads = argc > 1 ? strtol(argv[1], NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    long ops = argc > 2 ? strtol(argv[2], NULL, 10) : BENCH_DEFAULT_OPS;
+    if (max_threads < 1)
+        max_threads = 1;
+    if (max_threads > BENCH_MAX_THREADS)
+        max_threads = BENCH_MAX_THREADS;
+    if (ops < BENCH_BATCH)
+        ops = BENCH_BATCH;
+
+    static Worker workers[BENCH_MAX_THREADS];
+    g_clock_overhead = measure_clock_overhead();
+    int counts[2] = {1, (int)max_threads};
+
+    printf("backend,dist,threads,ops,mops_per_sec,p50_ns,p99_ns,p999_ns,max_ns\n");
+    for (size_t bi = 0; bi < sizeof(g_backends) / sizeof(g_backends[0]); bi++)
+        for (size_t di = 0; di < sizeof(g_dists) / sizeof(g_dists[0]); di++)
+            for (int ci = 0; ci < (max_threads > 1 ? 2 : 1); ci++)
+                bench_one(&g_backends[bi], &g_dists[di], counts[ci], (size_t)ops, workers);
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "a_memsuo.h"
+
+/*
+ * Bump-allocates 16-byte objects into an arena that starts with a tiny block
+ * and keeps doubling, and reports the average cost of an allocation for each
+ * block the arena reaches. With the cached current block the numbers should
+ * stay flat no matter how many blocks are already chained in. Batches that
+ * triggered a grow are left out so only the bump path is measured.
+ *
+ * A second run times zeroed 8 MiB ARENA_ALLOCs: on the first pass the blocks
+ * are fresh and the clear is skipped; after each reset the bytes are dirty
+ * and are cleared with streaming stores.
+ *
+ * A third run creates and destroys BENCH_SHORT_CYCLES small arenas, the
+ * per-request pattern the block cache is meant for.
+ */
+
+#define BENCH_BATCH 64
+#define BENCH_MAX_BLOCKS 64
+#define BENCH_TOTAL_BYTES ((size_t)1 << 27)
+#define BENCH_BIG_BYTES ((size_t)8 << 20)
+#define BENCH_BIG_COUNT 8
+#define BENCH_SHORT_CYCLES 1000000
+
+typedef struct
+{
+    char bytes[16];
+} Obj16;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int main(void)
+{
+    uint64_t block_ns[BENCH_MAX_BLOCKS] = {0};
+    size_t block_allocs[BENCH_MAX_BLOCKS] = {0};
+    size_t blocks = 1;
+    size_t allocated = 0;
+    uintptr_t sink = 0;
+
+    ARENA_SCOPE(arena, 64);
+    ArenaBlock *last = arena.current;
+
+    while (allocated < BENCH_TOTAL_BYTES && blocks < BENCH_MAX_BLOCKS)
+    {
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < BENCH_BATCH; i++)
+        {
+            Obj16 *o = ARENA_ALLOC_NOZERO(&arena, Obj16, 1);
+            if (!o)
+            {
+                fprintf(stderr, "Allocation failed\n");
+                return 1;
+            }
+            sink ^= (uintptr_t)o;
+        }
+        uint64_t t1 = now_ns();
+        allocated += BENCH_BATCH * sizeof(Obj16);
+        if (arena.current != last)
+        {
+            last = arena.current;
+            blocks++;
+            continue;
+        }
+        block_ns[blocks - 1] += t1 - t0;
+        block_allocs[blocks - 1] += BENCH_BATCH;
+    }
+
+    printf("%-8s %-12s %-10s\n", "blocks", "allocs", "ns/alloc");
+    for (size_t b = 0; b < blocks; b++)
+    {
+        if (!block_allocs[b])
+            continue;
+        printf("%-8zu %-12zu %-10.2f\n", b + 1, block_allocs[b], (double)block_ns[b] / (double)block_allocs[b]);
+    }
+
+    ARENA_SCOPE(big, BENCH_BIG_BYTES * BENCH_BIG_COUNT);
+    printf("\n%-8s %-16s\n", "pass", "us/8MiB zeroed");
+    for (int pass = 0; pass < 4; pass++)
+    {
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < BENCH_BIG_COUNT; i++)
+        {
+            char *buf = ARENA_ALLOC(&big, char, BENCH_BIG_BYTES);
+            if (!buf)
+            {
+                fprintf(stderr, "Allocation failed\n");
+                return 1;
+            }
+            buf[BENCH_BIG_BYTES - 1] = 1;
+            sink ^= (uintptr_t)buf;
+        }
+        uint64_t t1 = now_ns();
+        arena_reset(&big);
+        printf("%-8d %-16.1f\n", pass, (double)(t1 - t0) / 1e3 / BENCH_BIG_COUNT);
+    }
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_SHORT_CYCLES; i++)
+    {
+        Arena shortlived;
+        if (arena_init(&shortlived, 4096, 0) != 0)
+        {
+            fprintf(stderr, "Allocation failed\n");
+            return 1;
+        }
+        sink ^= (uintptr_t)ARENA_ALLOC_NOZERO(&shortlived, char, 64);
+        sink ^= (uintptr_t)ARENA_ALLOC_NOZERO(&shortlived, char, 8192);
+        arena_destroy(&shortlived);
+    }
+    uint64_t t1 = now_ns();
+#ifdef ENABLE_ARENA_BLOCK_CACHE
+    const char *cache = "on";
+#else
+    const char *cache = "off";
+#endif
+    printf("\nshort-lived arena cycle (block cache %s): %.1f ns\n", cache, (double)(t1 - t0) / BENCH_SHORT_CYCLES);
+    printf("(sink %lx)\n", (unsigned long)(sink & 0xff));
+    return 0;
+}
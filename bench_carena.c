@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "c_memsuo.h"
+
+/*
+ * Scaling benchmark: 1..N threads append 32-byte records into one shared
+ * arena, once through carena_alloc and once through arena_alloc behind a
+ * pthread mutex. Reports aggregate millions of allocations per second.
+ */
+
+#define BENCH_ALLOCS_PER_THREAD 1000000
+#define BENCH_MAX_THREADS 64
+
+typedef struct
+{
+    char bytes[32];
+} Obj32;
+
+typedef struct
+{
+    ConcurrentArena carena;
+    Arena arena;
+    pthread_mutex_t lock;
+    pthread_barrier_t start;
+} Shared;
+
+static Shared g_shared;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void *run_carena(void *arg)
+{
+    (void)arg;
+    uintptr_t sink = 0;
+    pthread_barrier_wait(&g_shared.start);
+    for (int i = 0; i < BENCH_ALLOCS_PER_THREAD; i++)
+        sink ^= (uintptr_t)CARENA_ALLOC_NOZERO(&g_shared.carena, Obj32, 1);
+    return (void *)sink;
+}
+
+static void *run_mutex(void *arg)
+{
+    (void)arg;
+    uintptr_t sink = 0;
+    pthread_barrier_wait(&g_shared.start);
+    for (int i = 0; i < BENCH_ALLOCS_PER_THREAD; i++)
+    {
+        pthread_mutex_lock(&g_shared.lock);
+        sink ^= (uintptr_t)ARENA_ALLOC_NOZERO(&g_shared.arena, Obj32, 1);
+        pthread_mutex_unlock(&g_shared.lock);
+    }
+    return (void *)sink;
+}
+
+static double run(void *(*fn)(void *), int threads)
+{
+    pthread_t tids[BENCH_MAX_THREADS];
+    pthread_barrier_init(&g_shared.start, NULL, (unsigned)threads + 1);
+    for (int t = 0; t < threads; t++)
+        pthread_create(&tids[t], NULL, fn, NULL);
+    pthread_barrier_wait(&g_shared.start);
+    uint64_t t0 = now_ns();
+    for (int t = 0; t < threads; t++)
+        pthread_join(tids[t], NULL);
+    uint64_t t1 = now_ns();
+    pthread_barrier_destroy(&g_shared.start);
+    return (double)threads * BENCH_ALLOCS_PER_THREAD / ((double)(t1 - t0) / 1e3);
+}
+
+int main(int argc, char **argv)
+{
+    long max_threads = argc > 1 ? strtol(argv[1], NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1)
+        max_threads = 1;
+    if (max_threads > BENCH_MAX_THREADS)
+        max_threads = BENCH_MAX_THREADS;
+    pthread_mutex_init(&g_shared.lock, NULL);
+
+    printf("%-8s %-16s %-16s\n", "threads", "carena Mops/s", "mutex Mops/s");
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        carena_init(&g_shared.carena, 1 << 20, 0);
+        double lock_free = run(run_carena, threads);
+        carena_destroy(&g_shared.carena);
+
+        arena_init(&g_shared.arena, 1 << 20, 0);
+        double locked = run(run_mutex, threads);
+        arena_destroy(&g_shared.arena);
+
+        printf("%-8d %-16.2f %-16.2f\n", threads, lock_free, locked);
+        if (threads < max_threads && threads * 2 > max_threads)
+            threads = (int)max_threads / 2;
+    }
+    pthread_mutex_destroy(&g_shared.lock);
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "m_memsuo.h"
+#include "h_memsuo.h"
+
+/*
+ * Container workloads: BENCH_KEYS random 64-bit keys are inserted, then
+ * looked up once each (hits) and BENCH_KEYS absent keys are probed (misses);
+ * separately BENCH_PUSHES ints are pushed onto a growing vector. Each runs on
+ * the arena-backed containers, on the same containers over malloc, and on
+ * what callers hand-roll with the MALLOC family: a chained hash table with
+ * one MALLOC per node and an array grown with REALLOC. Reports ns per op.
+ */
+
+#define BENCH_KEYS 1000000
+#define BENCH_PUSHES 20000000
+
+HMAP_DECLARE(BenchMap, uint64_t, uint64_t, hmap_hash_u64, HMAP_EQ)
+VEC_DECLARE(BenchVec, int);
+
+typedef struct ChainNode
+{
+    struct ChainNode *next;
+    uint64_t key;
+    uint64_t value;
+} ChainNode;
+
+typedef struct
+{
+    ChainNode **buckets;
+    size_t mask;
+    size_t len;
+} ChainMap;
+
+typedef struct
+{
+    double insert;
+    double hit;
+    double miss;
+} MapTimes;
+
+static uint64_t g_keys[BENCH_KEYS];
+static volatile uint64_t g_sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t next_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static MapTimes bench_hmap(ContainerHeap *heap)
+{
+    MapTimes t;
+    BenchMap map;
+    BenchMap_init(&map, heap);
+    uint64_t t0 = now_ns();
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+        *BenchMap_insert(&map, g_keys[i], NULL) = i;
+    uint64_t t1 = now_ns();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+        sum += *BenchMap_find(&map, g_keys[i]);
+    uint64_t t2 = now_ns();
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+        sum += BenchMap_find(&map, ~g_keys[i]) != NULL;
+    uint64_t t3 = now_ns();
+    g_sink = sum;
+    BenchMap_release(&map);
+    t.insert = (double)(t1 - t0) / BENCH_KEYS;
+    t.hit = (double)(t2 - t1) / BENCH_KEYS;
+    t.miss = (double)(t3 - t2) / BENCH_KEYS;
+    return t;
+}
+
+static void chain_grow(ChainMap *map)
+{
+    size_t cap = (map->mask + 1) * 2;
+    ChainNode **buckets = (ChainNode **)CALLOC(cap, sizeof(ChainNode *));
+    for (size_t b = 0; b <= map->mask; b++)
+    {
+        ChainNode *node = map->buckets[b];
+        while (node)
+        {
+            ChainNode *next = node->next;
+            size_t slot = hmap_hash_u64(node->key) & (cap - 1);
+            node->next = buckets[slot];
+            buckets[slot] = node;
+            node = next;
+        }
+    }
+    FREE(map->buckets);
+    map->buckets = buckets;
+    map->mask = cap - 1;
+}
+
+static uint64_t *chain_insert(ChainMap *map, uint64_t key)
+{
+    size_t slot = hmap_hash_u64(key) & map->mask;
+    for (ChainNode *node = map->buckets[slot]; node; node = node->next)
+        if (node->key == key)
+            return &node->value;
+    if (map->len >= map->mask + 1)
+    {
+        chain_grow(map);
+        slot = hmap_hash_u64(key) & map->mask;
+    }
+    ChainNode *node = (ChainNode *)MALLOC(sizeof(ChainNode));
+    node->key = key;
+    node->value = 0;
+    node->next = map->buckets[slot];
+    map->buckets[slot] = node;
+    map->len++;
+    return &node->value;
+}
+
+static uint64_t *chain_find(const ChainMap *map, uint64_t key)
+{
+    for (ChainNode *node = map->buckets[hmap_hash_u64(key) & map->mask]; node; node = node->next)
+        if (node->key == key)
+            return &node->value;
+    return NULL;
+}
+
+static MapTimes bench_chain(void)
+{
+    MapTimes t;
+    ChainMap map;
+    map.mask = 15;
+    map.len = 0;
+    map.buckets = (ChainNode **)CALLOC(16, sizeof(ChainNode *));
+    uint64_t t0 = now_ns();
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+        *chain_insert(&map, g_keys[i]) = i;
+    uint64_t t1 = now_ns();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+        sum += *chain_find(&map, g_keys[i]);
+    uint64_t t2 = now_ns();
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+        sum += chain_find(&map, ~g_keys[i]) != NULL;
+    uint64_t t3 = now_ns();
+    g_sink = sum;
+    for (size_t b = 0; b <= map.mask; b++)
+    {
+        ChainNode *node = map.buckets[b];
+        while (node)
+        {
+            ChainNode *next = node->next;
+            FREE(node);
+            node = next;
+        }
+    }
+    FREE(map.buckets);
+    t.insert = (double)(t1 - t0) / BENCH_KEYS;
+    t.hit = (double)(t2 - t1) / BENCH_KEYS;
+    t.miss = (double)(t3 - t2) / BENCH_KEYS;
+    return t;
+}
+
+static double bench_vec(ContainerHeap *heap)
+{
+    BenchVec v;
+    VEC_INIT(&v, heap);
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_PUSHES; i++)
+        VEC_PUSH(&v, i);
+    uint64_t t1 = now_ns();
+    g_sink = (uint64_t)v.data[BENCH_PUSHES - 1];
+    VEC_RELEASE(&v);
+    return (double)(t1 - t0) / BENCH_PUSHES;
+}
+
+static double bench_realloc_array(void)
+{
+    int *data = NULL;
+    size_t len = 0, cap = 0;
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_PUSHES; i++)
+    {
+        if (len == cap)
+        {
+            cap = cap ? cap * 2 : 8;
+            data = REALLOC_ARRAY(data, cap, int);
+        }
+        data[len++] = i;
+    }
+    uint64_t t1 = now_ns();
+    g_sink = (uint64_t)data[BENCH_PUSHES - 1];
+    FREE(data);
+    return (double)(t1 - t0) / BENCH_PUSHES;
+}
+
+int main(void)
+{
+#ifdef USE_JEMALLOC
+    const char *backend = "MALLOC (jemalloc)";
+#else
+    const char *backend = "MALLOC (libc)";
+#endif
+    uint64_t rng = 88172645463325252ull;
+    for (size_t i = 0; i < BENCH_KEYS; i++)
+        g_keys[i] = next_rand(&rng) | 1;
+
+    Arena arena;
+    arena_init(&arena, 1 << 20, 0);
+    ContainerHeap arena_heap, sys_heap;
+    container_heap_init(&arena_heap, &arena);
+    container_heap_init(&sys_heap, NULL);
+
+    MapTimes a = bench_hmap(&arena_heap);
+    MapTimes s = bench_hmap(&sys_heap);
+    MapTimes c = bench_chain();
+    printf("%-30s %-10s %-10s %-10s\n", "map (ns/op)", "insert", "hit", "miss");
+    printf("%-30s %-10.2f %-10.2f %-10.2f\n", "HMAP on arena", a.insert, a.hit, a.miss);
+    printf("%-30s %-10.2f %-10.2f %-10.2f\n", "HMAP on malloc", s.insert, s.hit, s.miss);
+    printf("%-30s %-10.2f %-10.2f %-10.2f\n", "chained, MALLOC per node", c.insert, c.hit, c.miss);
+
+    printf("\n%-30s %-10s\n", "vector (ns/push)", "push");
+    printf("%-30s %-10.2f\n", "VEC on arena", bench_vec(&arena_heap));
+    printf("%-30s %-10.2f\n", "VEC on malloc", bench_vec(&sys_heap));
+    printf("%-30s %-10.2f\n", backend, bench_realloc_array());
+    arena_destroy(&arena);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "r_memsuo.hpp"
+
+/*
+ * Request-shaped pmr workloads: each round builds a map of BENCH_ITEMS
+ * entries with string values, a list of BENCH_ITEMS nodes and a vector grown
+ * to BENCH_ITEMS ints, then drops them all. BENCH_ROUNDS rounds run against
+ * each resource; the monotonic resources are released between rounds, the
+ * others free node by node. Reports ns per item per round.
+ */
+
+#define BENCH_ITEMS 100000
+#define BENCH_ROUNDS 50
+
+static volatile std::size_t g_sink;
+
+static std::uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (std::uint64_t)ts.tv_sec * 1000000000ull + (std::uint64_t)ts.tv_nsec;
+}
+
+static void round_trip(std::pmr::memory_resource *resource)
+{
+    std::pmr::unordered_map<int, std::pmr::string> map(resource);
+    std::pmr::list<int> list(resource);
+    std::pmr::vector<int> vec(resource);
+    for (int i = 0; i < BENCH_ITEMS; i++)
+    {
+        map.emplace(i, "value string past the inline buffer");
+        list.push_back(i);
+        vec.push_back(i);
+    }
+    g_sink = map.size() + list.size() + vec.size();
+}
+
+template <typename Release> static double bench(std::pmr::memory_resource *resource, Release release)
+{
+    std::uint64_t t0 = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        round_trip(resource);
+        release();
+    }
+    std::uint64_t t1 = now_ns();
+    return (double)(t1 - t0) / ((double)BENCH_ROUNDS * BENCH_ITEMS);
+}
+
+int main()
+{
+#ifdef USE_JEMALLOC
+    const char *backend = "MallocResource (jemalloc)";
+#else
+    const char *backend = "MallocResource (libc)";
+#endif
+    memsuo::ArenaResource arena(1 << 20);
+    std::pmr::monotonic_buffer_resource monotonic(1 << 20);
+    std::pmr::unsynchronized_pool_resource pool;
+
+    double a = bench(&arena, [&] { arena.release(); });
+    double m = bench(&monotonic, [&] { monotonic.release(); });
+    double p = bench(&pool, [] {});
+    double j = bench(memsuo::malloc_resource(), [] {});
+    double n = bench(std::pmr::new_delete_resource(), [] {});
+
+    std::printf("%-34s %-10s\n", "resource", "ns/item");
+    std::printf("%-34s %-10.2f\n", "ArenaResource", a);
+    std::printf("%-34s %-10.2f\n", "monotonic_buffer_resource", m);
+    std::printf("%-34s %-10.2f\n", "unsynchronized_pool_resource", p);
+    std::printf("%-34s %-10.2f\n", backend, j);
+    std::printf("%-34s %-10.2f\n", "new_delete_resource", n);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "m_memsuo.h"
+#include "p_memsuo.h"
+
+/*
+ * High-churn fixed-size workload: keep BENCH_LIVE objects alive and
+ * repeatedly free and replace a pseudo-randomly chosen one. Runs the same
+ * sequence through a Pool and through MALLOC/FREE and reports ns per
+ * free+alloc pair.
+ */
+
+#define BENCH_LIVE 100000
+#define BENCH_OPS 20000000
+
+typedef struct
+{
+    int fd;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    char peer[46];
+} Session;
+
+static void *g_live[BENCH_LIVE];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t next_rand(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double bench_pool(void)
+{
+    Pool pool;
+    uint32_t rng = 2463534242u;
+    POOL_INIT(&pool, Session);
+    for (int i = 0; i < BENCH_LIVE; i++)
+        g_live[i] = POOL_ALLOC_NOZERO(&pool);
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_OPS; i++)
+    {
+        uint32_t k = next_rand(&rng) % BENCH_LIVE;
+        POOL_FREE(&pool, g_live[k]);
+        Session *s = POOL_ALLOC_NOZERO(&pool);
+        s->fd = i;
+        g_live[k] = s;
+    }
+    uint64_t t1 = now_ns();
+    pool_destroy(&pool);
+    return (double)(t1 - t0) / BENCH_OPS;
+}
+
+static double bench_malloc(void)
+{
+    uint32_t rng = 2463534242u;
+    for (int i = 0; i < BENCH_LIVE; i++)
+        g_live[i] = MALLOC(sizeof(Session));
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < BENCH_OPS; i++)
+    {
+        uint32_t k = next_rand(&rng) % BENCH_LIVE;
+        FREE(g_live[k]);
+        Session *s = (Session *)MALLOC(sizeof(Session));
+        s->fd = i;
+        g_live[k] = s;
+    }
+    uint64_t t1 = now_ns();
+    for (int i = 0; i < BENCH_LIVE; i++)
+        FREE(g_live[i]);
+    return (double)(t1 - t0) / BENCH_OPS;
+}
+
+int main(void)
+{
+#ifdef USE_JEMALLOC
+    const char *backend = "MALLOC/FREE (jemalloc)";
+#else
+    const char *backend = "MALLOC/FREE (libc)";
+#endif
+    printf("%-24s %-10s\n", "allocator", "ns/op");
+    printf("%-24s %-10.2f\n", "POOL_ALLOC/POOL_FREE", bench_pool());
+    printf("%-24s %-10.2f\n", backend, bench_malloc());
+    return 0;
+}
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "m_memsuo.h"
+#include "a_memsuo.h"
+
+/*
+ * Fragmentation and RSS soak. Each op frees everything whose lifetime has
+ * expired, then allocates and fills one object with MALLOC; a fraction of ops REALLOC
+ * a random live object instead, and every SOAK_ARENA_EVERY ops an arena is
+ * created, filled and destroyed. Sizes and lifetimes (in ops) come from the
+ * selected profiles; the "survivors" classes draw Pareto lifetimes so a few
+ * objects outlive most of the run and pin the pages around them.
+ *
+ * After every round it prints a CSV sample of requested live bytes, RSS
+ * above the starting baseline and, with USE_JEMALLOC, stats.resident. The
+ * summary reports the fragmentation ratio (RSS growth / live bytes) and the
+ * peak overhead (RSS growth minus live bytes).
+ *
+ * Usage: bench_soak [rounds] [ops_per_round] [small|mixed|large] [short|mixed|survivors]
+ */
+
+#define SOAK_DEFAULT_ROUNDS 50
+#define SOAK_DEFAULT_OPS 200000
+#define SOAK_REALLOC_PERCENT 5
+#define SOAK_ARENA_EVERY 5000
+
+typedef struct
+{
+    uint32_t weight;
+    uint64_t lo;
+    uint64_t hi; /* 0 selects a Pareto tail starting at lo */
+} SoakClass;
+
+typedef struct
+{
+    const char *name;
+    const SoakClass *classes;
+    size_t count;
+} SoakProfile;
+
+static const SoakClass g_size_small[] = {{100, 8, 256}};
+static const SoakClass g_size_mixed[] = {{80, 8, 256}, {15, 257, 4096}, {5, 4097, 65536}};
+static const SoakClass g_size_large[] = {{50, 8, 256}, {30, 4097, 65536}, {20, 65537, 1 << 20}};
+
+static const SoakClass g_life_short[] = {{100, 1, 1000}};
+static const SoakClass g_life_mixed[] = {{80, 1, 1000}, {18, 1000, 100000}, {2, 100000, 0}};
+static const SoakClass g_life_survivors[] = {{60, 1, 1000}, {30, 1000, 100000}, {10, 1000000, 0}};
+
+#define SOAK_PROFILE(name, arr) {name, arr, sizeof(arr) / sizeof(arr[0])}
+
+static const SoakProfile g_size_profiles[] = {
+    SOAK_PROFILE("small", g_size_small),
+    SOAK_PROFILE("mixed", g_size_mixed),
+    SOAK_PROFILE("large", g_size_large),
+};
+
+static const SoakProfile g_life_profiles[] = {
+    SOAK_PROFILE("short", g_life_short),
+    SOAK_PROFILE("mixed", g_life_mixed),
+    SOAK_PROFILE("survivors", g_life_survivors),
+};
+
+typedef struct
+{
+    uint64_t death;
+    void *ptr;
+    size_t size;
+} SoakObj;
+
+/* Min-heap on death time; the heap array itself uses libc so it stays out of the MALLOC stats. */
+typedef struct
+{
+    SoakObj *items;
+    size_t len;
+    size_t cap;
+} SoakHeap;
+
+static uint64_t g_rng = 0x9e3779b97f4a7c15ull;
+
+static inline uint64_t next_rand(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static uint64_t draw(const SoakProfile *p)
+{
+    uint32_t total = 0;
+    for (size_t i = 0; i < p->count; i++)
+        total += p->classes[i].weight;
+    uint32_t r = (uint32_t)(next_rand() % total);
+    const SoakClass *c = &p->classes[0];
+    for (size_t i = 0; i < p->count; i++)
+    {
+        c = &p->classes[i];
+        if (r < c->weight)
+            break;
+        r -= c->weight;
+    }
+    if (c->hi == 0)
+    {
+        /* Pareto with alpha = 1: lo / u for u uniform in (0, 1]. */
+        uint64_t u = (next_rand() >> 40) + 1;
+        return c->lo * ((uint64_t)1 << 24) / u;
+    }
+    return c->lo + next_rand() % (c->hi - c->lo + 1);
+}
+
+static const SoakProfile *find_profile(const SoakProfile *profiles, size_t n, const char *name)
+{
+    for (size_t i = 0; i < n; i++)
+        if (strcmp(profiles[i].name, name) == 0)
+            return &profiles[i];
+    return NULL;
+}
+
+static int heap_push(SoakHeap *h, SoakObj obj)
+{
+    if (h->len == h->cap)
+    {
+        size_t cap = h->cap ? h->cap * 2 : 4096;
+        SoakObj *items = (SoakObj *)realloc(h->items, cap * sizeof(SoakObj));
+        if (!items)
+            return -1;
+        h->items = items;
+        h->cap = cap;
+    }
+    size_t i = h->len++;
+    while (i > 0 && h->items[(i - 1) / 2].death > obj.death)
+    {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = obj;
+    return 0;
+}
+
+static SoakObj heap_pop(SoakHeap *h)
+{
+    SoakObj top = h->items[0];
+    SoakObj last = h->items[--h->len];
+    size_t i = 0;
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= h->len)
+            break;
+        if (child + 1 < h->len && h->items[child + 1].death < h->items[child].death)
+            child++;
+        if (last.death <= h->items[child].death)
+            break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->len)
+        h->items[i] = last;
+    return top;
+}
+
+static size_t rss_bytes(void)
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    unsigned long pages = 0, resident = 0;
+    if (!f)
+        return 0;
+    if (fscanf(f, "%lu %lu", &pages, &resident) != 2)
+        resident = 0;
+    fclose(f);
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static size_t allocator_resident(void)
+{
+#ifdef USE_JEMALLOC
+    uint64_t epoch = 1;
+    size_t len = sizeof(epoch);
+    je_mallctl("epoch", &epoch, &len, &epoch, len);
+    size_t resident = 0;
+    len = sizeof(resident);
+    if (je_mallctl("stats.resident", &resident, &len, NULL, 0) != 0)
+        return 0;
+    return resident;
+#else
+    return 0;
+#endif
+}
+
+static void arena_cycle(const SoakProfile *sizes)
+{
+    Arena arena;
+    if (arena_init(&arena, 64 * 1024, 0) != 0)
+        return;
+    size_t target = 64 * 1024 + (size_t)(next_rand() % (2 * 1024 * 1024));
+    for (size_t used = 0; used < target;)
+    {
+        size_t size = (size_t)draw(sizes);
+        unsigned char *p = (unsigned char *)arena_alloc(&arena, size, 16, 1, ARENA_NO_ZERO);
+        if (!p)
+            break;
+        p[0] = 1;
+        used += size;
+    }
+    arena_destroy(&arena);
+}
+
+int main(int argc, char **argv)
+{
+    long rounds = argc > 1 ? strtol(argv[1], NULL, 10) : SOAK_DEFAULT_ROUNDS;
+    long ops_per_round = argc > 2 ? strtol(argv[2], NULL, 10) : SOAK_DEFAULT_OPS;
+    const SoakProfile *sizes = find_profile(g_size_profiles, 3, argc > 3 ? argv[3] : "mixed");
+    const SoakProfile *lives = find_profile(g_life_profiles, 3, argc > 4 ? argv[4] : "mixed");
+    if (rounds < 1 || ops_per_round < 1 || !sizes || !lives)
+    {
+        fprintf(stderr, "usage: %s [rounds] [ops_per_round] [small|mixed|large] [short|mixed|survivors]\n", argv[0]);
+        return 1;
+    }
+
+    SoakHeap heap = {NULL, 0, 0};
+    size_t live = 0, peak_live = 0, peak_rss = 0, peak_overhead = 0;
+    size_t baseline = rss_bytes();
+    uint64_t op = 0;
+
+    printf("round,ops,live_objects,live_bytes,rss_bytes,allocator_resident,frag_ratio\n");
+    for (long round = 1; round <= rounds; round++)
+    {
+        for (long i = 0; i < ops_per_round; i++, op++)
+        {
+            while (heap.len && heap.items[0].death <= op)
+            {
+                SoakObj dead = heap_pop(&heap);
+                live -= dead.size;
+                FREE(dead.ptr);
+            }
+            if (heap.len && next_rand() % 100 < SOAK_REALLOC_PERCENT)
+            {
+                SoakObj *obj = &heap.items[next_rand() % heap.len];
+                size_t size = (size_t)draw(sizes);
+                void *p = REALLOC(obj->ptr, size);
+                if (p)
+                {
+                    if (size > obj->size)
+                        memset((unsigned char *)p + obj->size, 0x5a, size - obj->size);
+                    live = live - obj->size + size;
+                    obj->ptr = p;
+                    obj->size = size;
+                }
+            }
+            else
+            {
+                size_t size = (size_t)draw(sizes);
+                uint64_t life = draw(lives);
+                SoakObj obj = {life > UINT64_MAX - op ? UINT64_MAX : op + life, MALLOC(size), size};
+                if (!obj.ptr)
+                    continue;
+                memset(obj.ptr, 0xa5, size);
+                if (heap_push(&heap, obj) != 0)
+                {
+                    FREE(obj.ptr);
+                    continue;
+                }
+                live += size;
+            }
+            if (op % SOAK_ARENA_EVERY == 0)
+                arena_cycle(sizes);
+        }
+
+        size_t rss = rss_bytes();
+        size_t grown = rss > baseline ? rss - baseline : 0;
+        if (live > peak_live)
+            peak_live = live;
+        if (grown > peak_rss)
+            peak_rss = grown;
+        if (grown > live && grown - live > peak_overhead)
+            peak_overhead = grown - live;
+        printf("%ld,%llu,%zu,%zu,%zu,%zu,%.3f\n", round, (unsigned long long)op, heap.len, live, grown,
+               allocator_resident(), live ? (double)grown / (double)live : 0.0);
+        fflush(stdout);
+    }
+
+    size_t final_live = live;
+    size_t final_rss = rss_bytes();
+    while (heap.len)
+        FREE(heap_pop(&heap).ptr);
+    size_t drained_rss = rss_bytes();
+    free(heap.items);
+
+    printf("# size_profile=%s lifetime_profile=%s\n", sizes->name, lives->name);
+    printf("# peak_live_bytes=%zu peak_rss_growth=%zu peak_overhead_bytes=%zu\n", peak_live, peak_rss, peak_overhead);
+    printf("# final_frag_ratio=%.3f peak_frag_ratio=%.3f\n",
+           final_live ? (double)(final_rss > baseline ? final_rss - baseline : 0) / (double)final_live : 0.0,
+           peak_live ? (double)peak_rss / (double)peak_live : 0.0);
+    printf("# rss_growth_after_free=%zu\n", drained_rss > baseline ? drained_rss - baseline : 0);
+#ifdef ENABLE_MEM_STATS
+    mem_stats_print(stderr);
+#endif
+    return 0;
+}
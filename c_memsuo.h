@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef C_MEMSUO_H
+#define C_MEMSUO_H
+
+/**
+ * Concurrent arena.
+ *
+ * Many threads may allocate from one ConcurrentArena at the same time; the
+ * whole arena is still freed as a unit by a single thread once they are done.
+ * An allocation is one atomic fetch-add on the current block's `used` field.
+ * When a block runs out, one thread allocates a bigger one and publishes it
+ * while the others wait for it, so a full block costs a single allocation.
+ * Blocks are never freed before carena_destroy, so there is no reclamation
+ * hazard.
+ */
+
+#include <sched.h>
+#include "a_memsuo.h"
+
+/*
+ * Sizes and block capacities are rounded to this granule so requests with
+ * alignment up to it never need padding and can be reserved with a single
+ * fetch-add.
+ */
+#define CARENA_GRANULE 16
+
+typedef struct ConcurrentArena
+{
+    ArenaBlock *current;
+    int growing; /* set while one thread allocates the next block */
+    Arena owner; /* supplies block allocation and the secure flag; not bumped */
+} ConcurrentArena;
+
+#define CARENA_ALLOC(carenaPtr, Type, count)                                                                           \
+    ((Type *)carena_alloc((carenaPtr), sizeof(Type), _Alignof(Type), (count), 0))
+#define CARENA_ALLOC_NOZERO(carenaPtr, Type, count)                                                                    \
+    ((Type *)carena_alloc((carenaPtr), sizeof(Type), _Alignof(Type), (count), ARENA_NO_ZERO))
+
+static inline int carena_init(ConcurrentArena *carena, size_t initial_size, int secure_flag)
+{
+    carena->current = NULL;
+    carena->growing = 0;
+    if (arena_init(&carena->owner, 0, secure_flag) != 0)
+        return -1;
+    if (initial_size == 0)
+        return 0;
+    initial_size = (initial_size + (CARENA_GRANULE - 1)) & ~(size_t)(CARENA_GRANULE - 1);
+    carena->current = arena_block_new(&carena->owner, initial_size);
+    return carena->current ? 0 : -1;
+}
+
+/*
+ * Installs a block of at least `need` bytes after `seen` filled up. Only the
+ * thread that sets `growing` allocates; the others wait and retry on the
+ * block it publishes, and a block that replaced `seen` meanwhile is kept.
+ */
+static ARENA_NOINLINE int carena_grow(ConcurrentArena *carena, ArenaBlock *seen, size_t need)
+{
+    if (__atomic_exchange_n(&carena->growing, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&carena->growing, __ATOMIC_RELAXED))
+            sched_yield();
+        return 0;
+    }
+    int rc = 0;
+    if (__atomic_load_n(&carena->current, __ATOMIC_ACQUIRE) == seen)
+    {
+        size_t new_cap = need;
+        if (seen && seen->capacity <= SIZE_MAX / 2 && seen->capacity * 2 > need)
+            new_cap = seen->capacity * 2;
+        ArenaBlock *block = arena_block_new(&carena->owner, new_cap);
+        if (block)
+        {
+            block->next = seen;
+            __atomic_store_n(&carena->current, block, __ATOMIC_RELEASE);
+        }
+        else
+        {
+            rc = -1;
+        }
+    }
+    __atomic_store_n(&carena->growing, 0, __ATOMIC_RELEASE);
+    return rc;
+}
+
+static inline void *carena_alloc(ConcurrentArena *carena, size_t size, size_t align, size_t count, int flags)
+{
+    if (count == 0 || size == 0)
+        return NULL;
+    if (count > SIZE_MAX / size)
+        return NULL;
+    size_t total = size * count;
+    size_t reserve = total + (CARENA_GRANULE - 1);
+    if (align > CARENA_GRANULE)
+        reserve += align - CARENA_GRANULE;
+    if (reserve < total)
+        return NULL;
+    reserve &= ~(size_t)(CARENA_GRANULE - 1);
+    for (;;)
+    {
+        ArenaBlock *block = __atomic_load_n(&carena->current, __ATOMIC_ACQUIRE);
+        if (ARENA_LIKELY(block != NULL))
+        {
+            size_t off = __atomic_fetch_add(&block->used, reserve, __ATOMIC_RELAXED);
+            if (ARENA_LIKELY(off <= block->capacity && reserve <= block->capacity - off))
+            {
+                uintptr_t p = (uintptr_t)block->base + off;
+                p = (p + (align - 1)) & ~(uintptr_t)(align - 1);
+                /* `touched` is fixed while the block is current, and bytes past it are already zero. */
+                size_t start = (size_t)(p - (uintptr_t)block->base);
+                if (!(flags & ARENA_NO_ZERO) && start < block->touched)
+                    memset((void *)p, 0, total < block->touched - start ? total : block->touched - start);
+                return (void *)p;
+            }
+        }
+        if (carena_grow(carena, block, reserve) != 0)
+            return NULL;
+    }
+}
+
+/*
+ * Not thread-safe: every allocating thread must be finished. Each block's
+ * touched mark is raised to what was handed out first, since carena_alloc
+ * leaves it alone and a cached block may go on to serve a plain arena.
+ */
+static inline void carena_destroy(ConcurrentArena *carena)
+{
+    ArenaBlock *block = carena->current;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        size_t used = block->used < block->capacity ? block->used : block->capacity;
+        if (block->touched < used)
+            block->touched = used;
+        arena_block_free(&carena->owner, block);
+        block = next;
+    }
+    carena->current = NULL;
+    arena_destroy(&carena->owner);
+}
+
+#endif /* C_MEMSUO_H */
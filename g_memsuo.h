@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef G_MEMSUO_H
+#define G_MEMSUO_H
+
+/**
+ * Generational arenas.
+ *
+ * A GenArena rotates through a fixed ring of Arenas, one per generation, for
+ * data that lives for a bounded number of epochs: what epoch N produces is
+ * still valid while epoch N+1 (and, with more generations, later epochs)
+ * consume it. Allocations always go to the current generation.
+ * genarena_advance moves on to the oldest generation and resets it, which
+ * keeps its blocks, so once every generation has seen a peak epoch the ring
+ * allocates nothing from the system.
+ *
+ * Allocations that must outlive the ring are promoted: genarena_promote
+ * copies them into a caller-supplied long-lived arena, typically from the
+ * expire callback that genarena_advance runs on the generation it is about
+ * to reset. Like Arena, a GenArena must only be used by one thread at a time.
+ */
+
+#include "a_memsuo.h"
+
+#ifndef GENARENA_MAX_GENERATIONS
+#define GENARENA_MAX_GENERATIONS 8
+#endif
+
+typedef struct GenArena GenArena;
+
+/* Called with the generation about to be reset; promote what must survive. */
+typedef void (*GenArenaExpireFn)(GenArena *gen, Arena *expiring, void *ctx);
+
+struct GenArena
+{
+    Arena gens[GENARENA_MAX_GENERATIONS];
+    unsigned count;
+    unsigned current;
+    uint64_t epoch;
+    Arena *survivors; /* promotion target, owned by the caller */
+    GenArenaExpireFn on_expire;
+    void *expire_ctx;
+};
+
+#define GENARENA_ALLOC(genPtr, Type, count)                                                                            \
+    ((Type *)genarena_alloc((genPtr), sizeof(Type), _Alignof(Type), (count), 0))
+#define GENARENA_ALLOC_NOZERO(genPtr, Type, count)                                                                     \
+    ((Type *)genarena_alloc((genPtr), sizeof(Type), _Alignof(Type), (count), ARENA_NO_ZERO))
+#define GENARENA_PROMOTE(genPtr, ptr, Type, count)                                                                     \
+    ((Type *)genarena_promote((genPtr), (ptr), sizeof(Type) * (count), _Alignof(Type)))
+
+static void genarena_destroy(GenArena *gen);
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GENARENA_SCOPE(name, generations, initial_size)                                                                \
+    __attribute__((cleanup(genarena_destroy))) GenArena name;                                                          \
+    genarena_init(&(name), (generations), (initial_size), 0)
+#else
+#define GENARENA_SCOPE(name, generations, initial_size)                                                                \
+    GenArena name;                                                                                                     \
+    genarena_init(&(name), (generations), (initial_size), 0)
+#endif
+
+/*
+ * Sets up `generations` arenas (clamped to 2..GENARENA_MAX_GENERATIONS) of
+ * `initial_size` bytes each. Two generations is plain double buffering.
+ */
+static inline int genarena_init(GenArena *gen, unsigned generations, size_t initial_size, int secure_flag)
+{
+    if (generations < 2)
+        generations = 2;
+    if (generations > GENARENA_MAX_GENERATIONS)
+        generations = GENARENA_MAX_GENERATIONS;
+    gen->count = generations;
+    gen->current = 0;
+    gen->epoch = 0;
+    gen->survivors = NULL;
+    gen->on_expire = NULL;
+    gen->expire_ctx = NULL;
+    int rc = 0;
+    for (unsigned i = 0; i < generations; i++)
+    {
+        if (arena_init(&gen->gens[i], initial_size, secure_flag) != 0)
+            rc = -1;
+    }
+    return rc;
+}
+
+/* The arena of the generation `age` epochs old; 0 is the current one. */
+static inline Arena *genarena_arena(GenArena *gen, unsigned age)
+{
+    if (age >= gen->count)
+        return NULL;
+    return &gen->gens[(gen->current + gen->count - age) % gen->count];
+}
+
+static ARENA_ALWAYS_INLINE void *genarena_alloc(GenArena *gen, size_t size, size_t align, size_t count, int flags)
+{
+    return arena_alloc(&gen->gens[gen->current], size, align, count, flags);
+}
+
+/*
+ * Routes promotions to `survivors` and registers `on_expire`, which
+ * genarena_advance calls on the oldest generation before resetting it.
+ * Either may be NULL.
+ */
+static inline void genarena_set_promotion(GenArena *gen, Arena *survivors, GenArenaExpireFn on_expire, void *ctx)
+{
+    gen->survivors = survivors;
+    gen->on_expire = on_expire;
+    gen->expire_ctx = ctx;
+}
+
+/* Copies `size` bytes into the survivors arena and returns the copy. */
+static inline void *genarena_promote(GenArena *gen, const void *ptr, size_t size, size_t align)
+{
+    if (!gen->survivors || !ptr)
+        return NULL;
+    void *copy = arena_alloc(gen->survivors, size, align, 1, ARENA_NO_ZERO);
+    if (copy)
+        memcpy(copy, ptr, size);
+    return copy;
+}
+
+/*
+ * Ends the current epoch. The oldest generation is handed to the expire
+ * callback, then reset and made current, so everything allocated `count`
+ * epochs ago is released while newer generations stay intact. Returns the
+ * new epoch number.
+ */
+static inline uint64_t genarena_advance(GenArena *gen)
+{
+    unsigned next = (gen->current + 1) % gen->count;
+    Arena *oldest = &gen->gens[next];
+    if (gen->on_expire)
+        gen->on_expire(gen, oldest, gen->expire_ctx);
+    arena_reset(oldest);
+    gen->current = next;
+    return ++gen->epoch;
+}
+
+static void genarena_destroy(GenArena *gen)
+{
+    for (unsigned i = 0; i < gen->count; i++)
+        arena_destroy(&gen->gens[i]);
+    gen->count = 0;
+}
+
+#endif /* G_MEMSUO_H */
@@ -0,0 +1,538 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef H_MEMSUO_H
+#define H_MEMSUO_H
+
+/**
+ * Arena-backed containers.
+ *
+ * A ContainerHeap hands out storage for growable containers from an Arena
+ * and takes back the buffers they outgrow. Returned buffers are kept on free
+ * lists bucketed by the power of two below their size, so a later request
+ * of any size up to that power reuses them; nothing is ever given back to
+ * the arena, and arena_destroy releases every container at once. A heap
+ * whose arena is NULL uses malloc, realloc and free instead, which makes the
+ * same containers comparable against the system allocator.
+ *
+ * VEC_DECLARE makes a typed vector whose growth extends in place while its
+ * buffer is the arena's most recent allocation. HMAP_DECLARE makes a typed
+ * open-addressing hash map laid out like a Swiss table: one control byte per
+ * slot holding 7 bits of the hash, probed 16 at a time with SSE2 compares, so
+ * a lookup usually touches one control group and one slot. Keys and values
+ * are stored inline; entries move when the table grows, so pointers returned
+ * by find and insert are only valid until the next insert.
+ *
+ * Containers, like their arena, must only be used by one thread at a time.
+ * Buffers are 16-byte aligned, which bounds the alignment of element types.
+ */
+
+#include "a_memsuo.h"
+
+#define CONTAINER_ALIGN 16
+#define CONTAINER_HEAP_CLASSES 64
+
+#define HMAP_GROUP 16
+#define HMAP_EMPTY ((signed char)-128)
+#define HMAP_DELETED ((signed char)-2)
+
+typedef struct ContainerFree
+{
+    struct ContainerFree *next;
+    size_t size;
+} ContainerFree;
+
+typedef struct ContainerHeap
+{
+    Arena *arena;
+    ContainerFree *free[CONTAINER_HEAP_CLASSES];
+} ContainerHeap;
+
+/*
+ * Untyped table behind HMAP_DECLARE. `slots` holds `cap` entries and is
+ * followed by `cap + HMAP_GROUP` control bytes; the last HMAP_GROUP mirror the
+ * first so a group load never wraps. `growth_left` counts empty slots that
+ * may still be filled before the 7/8 load limit forces a rehash.
+ */
+typedef struct HMap
+{
+    unsigned char *slots;
+    signed char *ctrl;
+    size_t cap;
+    size_t len;
+    size_t growth_left;
+    ContainerHeap *heap;
+} HMap;
+
+static inline void container_heap_init(ContainerHeap *heap, Arena *arena)
+{
+    heap->arena = arena;
+    for (int i = 0; i < CONTAINER_HEAP_CLASSES; i++)
+        heap->free[i] = NULL;
+}
+
+static inline unsigned container_floor_log2(size_t n)
+{
+    return (unsigned)(sizeof(size_t) * 8 - 1) - (unsigned)__builtin_clzl((unsigned long)n);
+}
+
+/* Stores the usable size in *actual, which may exceed `size` for a recycled buffer. */
+static inline void *container_heap_alloc(ContainerHeap *heap, size_t size, size_t *actual)
+{
+    if (size > SIZE_MAX - CONTAINER_ALIGN)
+        return NULL;
+    size = (size + CONTAINER_ALIGN - 1) & ~(size_t)(CONTAINER_ALIGN - 1);
+    if (size < sizeof(ContainerFree))
+        size = sizeof(ContainerFree);
+    if (!heap->arena)
+    {
+        *actual = size;
+        return malloc(size);
+    }
+    unsigned bucket = container_floor_log2(size);
+    ContainerFree *buf = heap->free[bucket];
+    if (!buf || buf->size < size)
+    {
+        bucket += (size & (size - 1)) != 0;
+        buf = bucket < CONTAINER_HEAP_CLASSES ? heap->free[bucket] : NULL;
+    }
+    if (buf)
+    {
+        heap->free[bucket] = buf->next;
+        *actual = buf->size;
+        return buf;
+    }
+    *actual = size;
+    return arena_alloc(heap->arena, size, CONTAINER_ALIGN, 1, ARENA_NO_ZERO);
+}
+
+/* Returns a buffer of at least `size` usable bytes to the heap. */
+static inline void container_heap_free(ContainerHeap *heap, void *ptr, size_t size)
+{
+    if (!ptr)
+        return;
+    if (!heap->arena)
+    {
+        free(ptr);
+        return;
+    }
+    if (size < sizeof(ContainerFree))
+        return;
+    ContainerFree *buf = (ContainerFree *)ptr;
+    unsigned bucket = container_floor_log2(size);
+    buf->size = size;
+    buf->next = heap->free[bucket];
+    heap->free[bucket] = buf;
+}
+
+/*
+ * Grows a buffer to `new_size` bytes, keeping its contents. In an arena a
+ * buffer that is the most recent allocation goes through arena_realloc, which
+ * extends it in place when it can; otherwise it moves and the old one goes
+ * back on the free lists.
+ */
+static inline void *container_heap_grow(ContainerHeap *heap, void *ptr, size_t old_size, size_t new_size,
+                                        size_t *actual)
+{
+    if (!ptr)
+        return container_heap_alloc(heap, new_size, actual);
+    if (!heap->arena)
+    {
+        void *grown = realloc(ptr, new_size);
+        if (grown)
+            *actual = new_size;
+        return grown;
+    }
+    void *out;
+    if ((unsigned char *)ptr + old_size == heap->arena->ptr)
+    {
+        out = arena_realloc(heap->arena, ptr, old_size, new_size, CONTAINER_ALIGN, ARENA_NO_ZERO);
+        if (!out)
+            return NULL;
+        *actual = new_size;
+    }
+    else
+    {
+        out = container_heap_alloc(heap, new_size, actual);
+        if (!out)
+            return NULL;
+        memcpy(out, ptr, old_size);
+    }
+    if (out != ptr)
+        container_heap_free(heap, ptr, old_size);
+    return out;
+}
+
+/* Grows `data` to hold at least `min_cap` elements, at least doubling; NULL on failure. */
+static inline void *container_vec_grow(ContainerHeap *heap, void *data, size_t *cap, size_t elem_size, size_t min_cap)
+{
+    size_t new_cap = *cap ? *cap : 8;
+    while (new_cap < min_cap)
+    {
+        if (new_cap > SIZE_MAX / 2)
+            return NULL;
+        new_cap *= 2;
+    }
+    if (new_cap > SIZE_MAX / elem_size)
+        return NULL;
+    size_t actual;
+    void *grown = container_heap_grow(heap, data, *cap * elem_size, new_cap * elem_size, &actual);
+    if (grown)
+        *cap = actual / elem_size;
+    return grown;
+}
+
+#define VEC_DECLARE(Name, Type)                                                                                        \
+    typedef struct Name                                                                                                \
+    {                                                                                                                  \
+        Type *data;                                                                                                    \
+        size_t len;                                                                                                    \
+        size_t cap;                                                                                                    \
+        ContainerHeap *heap;                                                                                           \
+    } Name
+
+#define VEC_INIT(vecPtr, heapPtr)                                                                                      \
+    ((vecPtr)->data = NULL, (vecPtr)->len = 0, (vecPtr)->cap = 0, (vecPtr)->heap = (heapPtr))
+#define VEC_AT(vecPtr, i) ((vecPtr)->data[(i)])
+#define VEC_CLEAR(vecPtr) ((vecPtr)->len = 0)
+
+/* Evaluates to 0 on success and -1 when the storage could not grow. */
+#define VEC_RESERVE(vecPtr, min_cap)                                                                                   \
+    (__extension__({                                                                                                   \
+        int _vrc = 0;                                                                                                  \
+        if ((min_cap) > (vecPtr)->cap)                                                                                 \
+        {                                                                                                              \
+            void *_vdata = container_vec_grow((vecPtr)->heap, (vecPtr)->data, &(vecPtr)->cap,                          \
+                                              sizeof(*(vecPtr)->data), (min_cap));                                     \
+            if (_vdata)                                                                                                \
+                (vecPtr)->data = (__typeof__((vecPtr)->data))_vdata;                                                   \
+            else                                                                                                       \
+                _vrc = -1;                                                                                             \
+        }                                                                                                              \
+        _vrc;                                                                                                          \
+    }))
+
+#define VEC_PUSH(vecPtr, value)                                                                                        \
+    (__extension__({                                                                                                   \
+        int _vprc = 0;                                                                                                 \
+        if (ARENA_UNLIKELY((vecPtr)->len == (vecPtr)->cap))                                                            \
+            _vprc = VEC_RESERVE((vecPtr), (vecPtr)->len + 1);                                                          \
+        if (_vprc == 0)                                                                                                \
+            (vecPtr)->data[(vecPtr)->len++] = (value);                                                                 \
+        _vprc;                                                                                                         \
+    }))
+
+#define VEC_POP(vecPtr) ((vecPtr)->data[--(vecPtr)->len])
+
+/* Hands the storage back to the heap; the vector is empty and reusable afterwards. */
+#define VEC_RELEASE(vecPtr)                                                                                            \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        container_heap_free((vecPtr)->heap, (vecPtr)->data, (vecPtr)->cap * sizeof(*(vecPtr)->data));                  \
+        (vecPtr)->data = NULL;                                                                                         \
+        (vecPtr)->len = 0;                                                                                             \
+        (vecPtr)->cap = 0;                                                                                             \
+    } while (0)
+
+/* Mixers for common key types; any function of the key to uint64_t works. */
+static inline uint64_t hmap_hash_u64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t hmap_hash_bytes(const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = 0xcbf29ce484222325ull ^ len;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    return hmap_hash_u64(h);
+}
+
+static inline uint64_t hmap_hash_str(const char *s)
+{
+    return hmap_hash_bytes(s, strlen(s));
+}
+
+/* Bit i is set when control byte i of the group equals `h2`. */
+static inline unsigned hmap_match(const signed char *ctrl, signed char h2)
+{
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+#else
+    unsigned bits = 0;
+    for (int i = 0; i < HMAP_GROUP; i++)
+        bits |= (unsigned)(ctrl[i] == h2) << i;
+    return bits;
+#endif
+}
+
+/* Bit i is set when slot i of the group is empty or deleted. */
+static inline unsigned hmap_match_free(const signed char *ctrl)
+{
+#if defined(__SSE2__)
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    unsigned bits = 0;
+    for (int i = 0; i < HMAP_GROUP; i++)
+        bits |= (unsigned)(ctrl[i] < 0) << i;
+    return bits;
+#endif
+}
+
+static inline void hmap_init(HMap *map, ContainerHeap *heap)
+{
+    map->slots = NULL;
+    map->ctrl = NULL;
+    map->cap = 0;
+    map->len = 0;
+    map->growth_left = 0;
+    map->heap = heap;
+}
+
+static inline void hmap_set_ctrl(HMap *map, size_t i, signed char value)
+{
+    map->ctrl[i] = value;
+    if (i < HMAP_GROUP)
+        map->ctrl[map->cap + i] = value;
+}
+
+static ARENA_ALWAYS_INLINE void *hmap_find_raw(const HMap *map, const void *key, uint64_t hash, size_t entry_size,
+                                               int (*eq)(const void *entry, const void *key))
+{
+    if (ARENA_UNLIKELY(map->cap == 0))
+        return NULL;
+    size_t mask = map->cap - 1;
+    size_t pos = (size_t)(hash >> 7) & mask;
+    signed char h2 = (signed char)(hash & 0x7f);
+    for (size_t step = HMAP_GROUP;; step += HMAP_GROUP)
+    {
+        unsigned bits = hmap_match(map->ctrl + pos, h2);
+        while (bits)
+        {
+            size_t i = (pos + (size_t)__builtin_ctz(bits)) & mask;
+            void *entry = map->slots + i * entry_size;
+            if (ARENA_LIKELY(eq(entry, key)))
+                return entry;
+            bits &= bits - 1;
+        }
+        if (ARENA_LIKELY(hmap_match(map->ctrl + pos, HMAP_EMPTY) != 0))
+            return NULL;
+        pos = (pos + step) & mask;
+    }
+}
+
+/* First empty or deleted slot on the probe sequence of `hash`. */
+static inline size_t hmap_find_free(const HMap *map, uint64_t hash)
+{
+    size_t mask = map->cap - 1;
+    size_t pos = (size_t)(hash >> 7) & mask;
+    for (size_t step = HMAP_GROUP;; step += HMAP_GROUP)
+    {
+        unsigned bits = hmap_match_free(map->ctrl + pos);
+        if (bits)
+            return (pos + (size_t)__builtin_ctz(bits)) & mask;
+        pos = (pos + step) & mask;
+    }
+}
+
+/*
+ * Moves every entry into a table of `new_cap` slots. A table that filled up
+ * mostly with deleted slots is rebuilt at the same size.
+ */
+static ARENA_NOINLINE int hmap_rehash(HMap *map, size_t new_cap, size_t entry_size,
+                                      uint64_t (*hash_entry)(const void *entry))
+{
+    if (new_cap > (SIZE_MAX - HMAP_GROUP) / (entry_size + 1))
+        return -1;
+    size_t slot_bytes = new_cap * entry_size;
+    slot_bytes = (slot_bytes + CONTAINER_ALIGN - 1) & ~(size_t)(CONTAINER_ALIGN - 1);
+    size_t actual;
+    unsigned char *buf = (unsigned char *)container_heap_alloc(map->heap, slot_bytes + new_cap + HMAP_GROUP, &actual);
+    if (!buf)
+        return -1;
+    HMap old = *map;
+    map->slots = buf;
+    map->ctrl = (signed char *)(buf + slot_bytes);
+    map->cap = new_cap;
+    map->growth_left = new_cap - new_cap / 8 - old.len;
+    memset(map->ctrl, (unsigned char)HMAP_EMPTY, new_cap + HMAP_GROUP);
+    for (size_t i = 0; i < old.cap; i++)
+    {
+        if (old.ctrl[i] < 0)
+            continue;
+        const unsigned char *entry = old.slots + i * entry_size;
+        uint64_t hash = hash_entry(entry);
+        size_t slot = hmap_find_free(map, hash);
+        hmap_set_ctrl(map, slot, (signed char)(hash & 0x7f));
+        memcpy(map->slots + slot * entry_size, entry, entry_size);
+    }
+    if (old.slots)
+    {
+        size_t old_slot_bytes = (old.cap * entry_size + CONTAINER_ALIGN - 1) & ~(size_t)(CONTAINER_ALIGN - 1);
+        container_heap_free(map->heap, old.slots, old_slot_bytes + old.cap + HMAP_GROUP);
+    }
+    return 0;
+}
+
+/*
+ * Returns the entry for `key`, claiming a slot for it when absent; *inserted
+ * says which. A new entry's bytes are zeroed and the caller stores the key.
+ */
+static ARENA_ALWAYS_INLINE void *hmap_insert_raw(HMap *map, const void *key, uint64_t hash, size_t entry_size,
+                                                 int (*eq)(const void *entry, const void *key),
+                                                 uint64_t (*hash_entry)(const void *entry), int *inserted)
+{
+    void *entry = hmap_find_raw(map, key, hash, entry_size, eq);
+    if (entry)
+    {
+        *inserted = 0;
+        return entry;
+    }
+    size_t slot = map->cap ? hmap_find_free(map, hash) : 0;
+    if (ARENA_UNLIKELY(map->cap == 0 || (map->growth_left == 0 && map->ctrl[slot] == HMAP_EMPTY)))
+    {
+        size_t new_cap = map->cap == 0 ? HMAP_GROUP : map->len * 2 >= map->cap ? map->cap * 2 : map->cap;
+        if (hmap_rehash(map, new_cap, entry_size, hash_entry) != 0)
+            return NULL;
+        slot = hmap_find_free(map, hash);
+    }
+    if (map->ctrl[slot] == HMAP_EMPTY)
+        map->growth_left--;
+    hmap_set_ctrl(map, slot, (signed char)(hash & 0x7f));
+    map->len++;
+    entry = map->slots + slot * entry_size;
+    memset(entry, 0, entry_size);
+    *inserted = 1;
+    return entry;
+}
+
+/* Marks the entry's slot deleted; the slot is reclaimed by the next rehash. */
+static inline void hmap_erase_raw(HMap *map, void *entry, size_t entry_size)
+{
+    size_t slot = (size_t)((unsigned char *)entry - map->slots) / entry_size;
+    hmap_set_ctrl(map, slot, HMAP_DELETED);
+    map->len--;
+}
+
+/* Walks full slots: start with *iter = 0, returns NULL at the end. */
+static inline void *hmap_next_raw(const HMap *map, size_t *iter, size_t entry_size)
+{
+    for (size_t i = *iter; i < map->cap; i++)
+    {
+        if (map->ctrl[i] >= 0)
+        {
+            *iter = i + 1;
+            return map->slots + i * entry_size;
+        }
+    }
+    *iter = map->cap;
+    return NULL;
+}
+
+static inline void hmap_release(HMap *map, size_t entry_size)
+{
+    if (map->slots)
+    {
+        size_t slot_bytes = (map->cap * entry_size + CONTAINER_ALIGN - 1) & ~(size_t)(CONTAINER_ALIGN - 1);
+        container_heap_free(map->heap, map->slots, slot_bytes + map->cap + HMAP_GROUP);
+    }
+    hmap_init(map, map->heap);
+}
+
+#define HMAP_EQ(a, b) ((a) == (b))
+
+/*
+ * Declares `Name`, a map from Key to Val, and its functions Name_init,
+ * Name_find, Name_insert, Name_erase, Name_size, Name_next and Name_release.
+ * `hash_fn(key)` returns a uint64_t and `eq_fn(a, b)` is nonzero for equal
+ * keys; both may be macros. Name_insert returns a zeroed value for a new key.
+ */
+#define HMAP_DECLARE(Name, Key, Val, hash_fn, eq_fn)                                                                   \
+    typedef struct Name##Entry                                                                                         \
+    {                                                                                                                  \
+        Key key;                                                                                                       \
+        Val value;                                                                                                     \
+    } Name##Entry;                                                                                                     \
+    typedef struct Name                                                                                                \
+    {                                                                                                                  \
+        HMap map;                                                                                                      \
+    } Name;                                                                                                            \
+    static inline int Name##_eq(const void *entry, const void *key)                                                    \
+    {                                                                                                                  \
+        return eq_fn(((const Name##Entry *)entry)->key, *(const Key *)key);                                            \
+    }                                                                                                                  \
+    static inline uint64_t Name##_hash_entry(const void *entry)                                                        \
+    {                                                                                                                  \
+        return hash_fn(((const Name##Entry *)entry)->key);                                                             \
+    }                                                                                                                  \
+    static inline void Name##_init(Name *m, ContainerHeap *heap)                                                       \
+    {                                                                                                                  \
+        hmap_init(&m->map, heap);                                                                                      \
+    }                                                                                                                  \
+    static inline Val *Name##_find(const Name *m, Key key)                                                             \
+    {                                                                                                                  \
+        Name##Entry *e = (Name##Entry *)hmap_find_raw(&m->map, &key, hash_fn(key), sizeof(Name##Entry), Name##_eq);    \
+        return e ? &e->value : NULL;                                                                                   \
+    }                                                                                                                  \
+    static inline Val *Name##_insert(Name *m, Key key, int *inserted)                                                  \
+    {                                                                                                                  \
+        int ins;                                                                                                       \
+        Name##Entry *e = (Name##Entry *)hmap_insert_raw(&m->map, &key, hash_fn(key), sizeof(Name##Entry), Name##_eq,   \
+                                                        Name##_hash_entry, &ins);                                      \
+        if (!e)                                                                                                        \
+            return NULL;                                                                                               \
+        if (ins)                                                                                                       \
+            e->key = key;                                                                                              \
+        if (inserted)                                                                                                  \
+            *inserted = ins;                                                                                           \
+        return &e->value;                                                                                              \
+    }                                                                                                                  \
+    static inline int Name##_erase(Name *m, Key key)                                                                   \
+    {                                                                                                                  \
+        void *e = hmap_find_raw(&m->map, &key, hash_fn(key), sizeof(Name##Entry), Name##_eq);                          \
+        if (!e)                                                                                                        \
+            return -1;                                                                                                 \
+        hmap_erase_raw(&m->map, e, sizeof(Name##Entry));                                                               \
+        return 0;                                                                                                      \
+    }                                                                                                                  \
+    static inline size_t Name##_size(const Name *m)                                                                    \
+    {                                                                                                                  \
+        return m->map.len;                                                                                             \
+    }                                                                                                                  \
+    static inline Name##Entry *Name##_next(const Name *m, size_t *iter)                                                \
+    {                                                                                                                  \
+        return (Name##Entry *)hmap_next_raw(&m->map, iter, sizeof(Name##Entry));                                       \
+    }                                                                                                                  \
+    static inline void Name##_release(Name *m)                                                                         \
+    {                                                                                                                  \
+        hmap_release(&m->map, sizeof(Name##Entry));                                                                    \
+    }
+
+#endif /* H_MEMSUO_H */
@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef I_MEMSUO_H
+#define I_MEMSUO_H
+
+/**
+ * String interning.
+ *
+ * An Interner stores each distinct byte string once in an Arena and hands
+ * back the same pointer every time that string is interned again, so
+ * interned strings compare with == and hash by address. Each copy is
+ * preceded by its precomputed hash and length and followed by a NUL, so
+ * intern_len and intern_hash are O(1), and the result can be passed anywhere
+ * a C string goes. The dedup table is an HMap from h_memsuo.h whose slots
+ * hold only a pointer; growing it reuses the stored hashes rather than
+ * rehashing the bytes.
+ *
+ * Interned strings live until the arena is destroyed or reset; an Interner
+ * must not outlive a reset of its arena. Like the arena, it must only be used
+ * by one thread at a time.
+ */
+
+#include <stddef.h>
+#include "h_memsuo.h"
+
+typedef struct InternStr
+{
+    uint64_t hash;
+    size_t len;
+    char bytes[];
+} InternStr;
+
+typedef struct Interner
+{
+    Arena *arena;
+    ContainerHeap heap;
+    HMap map;         /* slots are InternStr pointers */
+    size_t bytes;     /* string bytes stored, excluding headers and NULs */
+    size_t hits;      /* intern calls answered with an existing copy */
+    size_t hit_bytes; /* bytes those calls did not have to copy */
+} Interner;
+
+typedef struct InternKey
+{
+    const char *s;
+    size_t len;
+    uint64_t hash;
+} InternKey;
+
+#define INTERN_EQ(a, b) ((a) == (b))
+
+static inline const InternStr *intern_header(const char *s)
+{
+    return (const InternStr *)(const void *)(s - offsetof(InternStr, bytes));
+}
+
+/* Length of an interned string without scanning it. */
+static inline size_t intern_len(const char *s)
+{
+    return intern_header(s)->len;
+}
+
+/* Hash of an interned string's bytes, as computed by hmap_hash_bytes. */
+static inline uint64_t intern_hash(const char *s)
+{
+    return intern_header(s)->hash;
+}
+
+static inline int interner_eq(const void *entry, const void *key)
+{
+    const InternStr *str = *(InternStr *const *)entry;
+    const InternKey *k = (const InternKey *)key;
+    return str->hash == k->hash && str->len == k->len && memcmp(str->bytes, k->s, k->len) == 0;
+}
+
+static inline uint64_t interner_hash_entry(const void *entry)
+{
+    return (*(InternStr *const *)entry)->hash;
+}
+
+static inline void interner_init(Interner *in, Arena *arena)
+{
+    in->arena = arena;
+    container_heap_init(&in->heap, arena);
+    hmap_init(&in->map, &in->heap);
+    in->bytes = 0;
+    in->hits = 0;
+    in->hit_bytes = 0;
+}
+
+/* The interned copy of `s`, or NULL if it has not been interned. */
+static inline const char *interner_find(const Interner *in, const char *s, size_t len)
+{
+    InternKey key = {s, len, hmap_hash_bytes(s, len)};
+    InternStr **slot = (InternStr **)hmap_find_raw(&in->map, &key, key.hash, sizeof(InternStr *), interner_eq);
+    return slot ? (*slot)->bytes : NULL;
+}
+
+/* Returns the single stored copy of the `len` bytes at `s`, copying them on first sight. */
+static inline const char *intern(Interner *in, const char *s, size_t len)
+{
+    InternKey key = {s, len, hmap_hash_bytes(s, len)};
+    int inserted;
+    InternStr **slot = (InternStr **)hmap_insert_raw(&in->map, &key, key.hash, sizeof(InternStr *), interner_eq,
+                                                     interner_hash_entry, &inserted);
+    if (!slot)
+        return NULL;
+    if (!inserted)
+    {
+        in->hits++;
+        in->hit_bytes += len;
+        return (*slot)->bytes;
+    }
+    InternStr *str = NULL;
+    if (len <= SIZE_MAX - sizeof(InternStr) - 1)
+        str = (InternStr *)arena_alloc(in->arena, sizeof(InternStr) + len + 1, _Alignof(InternStr), 1,
+                                       ARENA_NO_ZERO);
+    if (!str)
+    {
+        hmap_erase_raw(&in->map, slot, sizeof(InternStr *));
+        return NULL;
+    }
+    str->hash = key.hash;
+    str->len = len;
+    memcpy(str->bytes, s, len);
+    str->bytes[len] = '\0';
+    *slot = str;
+    in->bytes += len;
+    return str->bytes;
+}
+
+static inline const char *intern_cstr(Interner *in, const char *s)
+{
+    return intern(in, s, strlen(s));
+}
+
+/* Number of distinct strings interned. */
+static inline size_t interner_count(const Interner *in)
+{
+    return in->map.len;
+}
+
+#endif /* I_MEMSUO_H */
@@ -0,0 +1,292 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef L_MEMSUO_H
+#define L_MEMSUO_H
+
+/**
+ * Allocation latency histograms (ENABLE_MEM_LATENCY).
+ *
+ * m_memsuo.h and a_memsuo.h include this header; with ENABLE_MEM_LATENCY
+ * defined they time every MALLOC-family call and arena_grow with the TSC
+ * (x86-64), the virtual counter (AArch64) or CLOCK_MONOTONIC, and arena_alloc
+ * too when MEMLAT_TIME_ARENA_ALLOC is defined. Each
+ * thread records into its own log-linear histograms (MEMLAT_SUB_BUCKETS
+ * linear buckets per power of two, so about 6% resolution) without atomic
+ * read-modify-writes; queries sum every thread's histograms. Per-thread
+ * histograms are registered on first use and kept for the life of the
+ * process so samples from exited threads are not lost.
+ *
+ * The registry is defined weakly below, so programs need no definition of
+ * their own.
+ * Define MEMLAT_REPORT_AT_EXIT to print the report to stderr at exit.
+ * Without ENABLE_MEM_LATENCY the hooks compile to nothing.
+ */
+
+#ifdef ENABLE_MEM_LATENCY
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef enum MemLatOp
+{
+    MEMLAT_MALLOC,
+    MEMLAT_CALLOC,
+    MEMLAT_REALLOC,
+    MEMLAT_FREE,
+    MEMLAT_ALIGNED_ALLOC,
+    MEMLAT_SODIUM_MALLOC,
+    MEMLAT_SODIUM_FREE,
+    MEMLAT_ARENA_ALLOC,
+    MEMLAT_ARENA_GROW,
+    MEMLAT_OP_COUNT
+} MemLatOp;
+
+#define MEMLAT_SUB_BITS 4
+#define MEMLAT_SUB_BUCKETS (1 << MEMLAT_SUB_BITS)
+#define MEMLAT_MAX_EXPONENT 48
+#define MEMLAT_BUCKETS ((MEMLAT_MAX_EXPONENT - MEMLAT_SUB_BITS + 1) * MEMLAT_SUB_BUCKETS)
+
+typedef struct MemLatThread
+{
+    struct MemLatThread *next;
+    uint64_t count[MEMLAT_OP_COUNT];
+    uint64_t max[MEMLAT_OP_COUNT];
+    uint64_t buckets[MEMLAT_OP_COUNT][MEMLAT_BUCKETS];
+} MemLatThread;
+
+typedef struct MemLatency
+{
+    int lock;
+    int exit_registered;
+    MemLatThread *threads;
+    double ticks_per_ns; /* 0 until calibrated */
+} MemLatency;
+
+/* Latency summary for one operation type, in nanoseconds. */
+typedef struct MemLatencyStats
+{
+    uint64_t count;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+} MemLatencyStats;
+
+__attribute__((weak)) MemLatency g_mem_latency;
+
+static __thread MemLatThread *__memlat_self;
+
+static inline uint64_t memlat_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void __memlat_lock(void)
+{
+    while (__atomic_exchange_n(&g_mem_latency.lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&g_mem_latency.lock, __ATOMIC_RELAXED))
+            ;
+    }
+}
+
+static inline void __memlat_unlock(void)
+{
+    __atomic_store_n(&g_mem_latency.lock, 0, __ATOMIC_RELEASE);
+}
+
+static inline size_t __memlat_bucket(uint64_t ticks)
+{
+    if (ticks < MEMLAT_SUB_BUCKETS)
+        return (size_t)ticks;
+    unsigned e = 63 - (unsigned)__builtin_clzll(ticks);
+    if (e >= MEMLAT_MAX_EXPONENT)
+        return MEMLAT_BUCKETS - 1;
+    size_t sub = (size_t)(ticks >> (e - MEMLAT_SUB_BITS)) & (MEMLAT_SUB_BUCKETS - 1);
+    return ((size_t)(e - MEMLAT_SUB_BITS + 1) << MEMLAT_SUB_BITS) | sub;
+}
+
+/* Largest tick value that falls in `bucket`. */
+static inline uint64_t __memlat_bucket_upper(size_t bucket)
+{
+    if (bucket < MEMLAT_SUB_BUCKETS)
+        return bucket;
+    unsigned e = (unsigned)(bucket >> MEMLAT_SUB_BITS) + MEMLAT_SUB_BITS - 1;
+    uint64_t low = (uint64_t)(MEMLAT_SUB_BUCKETS + (bucket & (MEMLAT_SUB_BUCKETS - 1))) << (e - MEMLAT_SUB_BITS);
+    return low + ((uint64_t)1 << (e - MEMLAT_SUB_BITS)) - 1;
+}
+
+static __attribute__((noinline)) MemLatThread *__memlat_register(void)
+{
+    MemLatThread *self = (MemLatThread *)calloc(1, sizeof(MemLatThread));
+    if (!self)
+        return NULL;
+    __memlat_lock();
+    self->next = g_mem_latency.threads;
+    g_mem_latency.threads = self;
+    __memlat_unlock();
+    __memlat_self = self;
+    return self;
+}
+
+/* Single-writer update: only the owning thread writes its histograms. */
+static inline void memlat_record(MemLatOp op, uint64_t ticks)
+{
+    MemLatThread *self = __memlat_self;
+    if (__builtin_expect(self == NULL, 0) && !(self = __memlat_register()))
+        return;
+    uint64_t *bucket = &self->buckets[op][__memlat_bucket(ticks)];
+    __atomic_store_n(bucket, __atomic_load_n(bucket, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&self->count[op], __atomic_load_n(&self->count[op], __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    if (ticks > __atomic_load_n(&self->max[op], __ATOMIC_RELAXED))
+        __atomic_store_n(&self->max[op], ticks, __ATOMIC_RELAXED);
+}
+
+/* Measures counter ticks per nanosecond once, over a ~10 ms busy wait. */
+static inline double __memlat_ticks_per_ns(void)
+{
+    double ratio;
+    __atomic_load(&g_mem_latency.ticks_per_ns, &ratio, __ATOMIC_RELAXED);
+    if (ratio > 0.0)
+        return ratio;
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    uint64_t t0 = memlat_now();
+    uint64_t elapsed;
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        elapsed = (uint64_t)(b.tv_sec - a.tv_sec) * 1000000000ull + (uint64_t)b.tv_nsec - (uint64_t)a.tv_nsec;
+    } while (elapsed < 10000000ull);
+    ratio = (double)(memlat_now() - t0) / (double)elapsed;
+#else
+    ratio = 1.0;
+#endif
+    __atomic_store(&g_mem_latency.ticks_per_ns, &ratio, __ATOMIC_RELAXED);
+    return ratio;
+}
+
+static inline int mem_latency_query(MemLatOp op, MemLatencyStats *out)
+{
+    static __thread uint64_t merged[MEMLAT_BUCKETS];
+    uint64_t max = 0;
+    memset(out, 0, sizeof(*out));
+    if ((unsigned)op >= MEMLAT_OP_COUNT)
+        return -1;
+    memset(merged, 0, sizeof(merged));
+    __memlat_lock();
+    for (MemLatThread *t = g_mem_latency.threads; t; t = t->next)
+    {
+        out->count += __atomic_load_n(&t->count[op], __ATOMIC_RELAXED);
+        uint64_t tmax = __atomic_load_n(&t->max[op], __ATOMIC_RELAXED);
+        if (tmax > max)
+            max = tmax;
+        for (size_t b = 0; b < MEMLAT_BUCKETS; b++)
+            merged[b] += __atomic_load_n(&t->buckets[op][b], __ATOMIC_RELAXED);
+    }
+    __memlat_unlock();
+    if (out->count == 0)
+        return 0;
+
+    double per_ns = __memlat_ticks_per_ns();
+    uint64_t total = 0;
+    for (size_t b = 0; b < MEMLAT_BUCKETS; b++)
+        total += merged[b];
+    const double quantiles[3] = {0.50, 0.99, 0.999};
+    double *targets[3] = {&out->p50_ns, &out->p99_ns, &out->p999_ns};
+    uint64_t seen = 0;
+    size_t q = 0;
+    for (size_t b = 0; b < MEMLAT_BUCKETS && q < 3; b++)
+    {
+        seen += merged[b];
+        while (q < 3 && (double)seen >= quantiles[q] * (double)total && merged[b])
+        {
+            uint64_t upper = __memlat_bucket_upper(b);
+            *targets[q++] = (double)(upper < max ? upper : max) / per_ns;
+        }
+    }
+    out->max_ns = (double)max / per_ns;
+    return 0;
+}
+
+static inline void mem_latency_report(FILE *out)
+{
+    static const char *const names[MEMLAT_OP_COUNT] = {
+        "MALLOC", "CALLOC", "REALLOC", "FREE", "ALIGNED_ALLOC", "SODIUM_MALLOC", "SODIUM_FREE", "arena_alloc",
+        "arena_grow"};
+    fprintf(out, "Allocation latency (ns):\n");
+    fprintf(out, "  %-14s %12s %10s %10s %10s %12s\n", "op", "count", "p50", "p99", "p999", "max");
+    for (int op = 0; op < MEMLAT_OP_COUNT; op++)
+    {
+        MemLatencyStats stats;
+        mem_latency_query((MemLatOp)op, &stats);
+        if (stats.count == 0)
+            continue;
+        fprintf(out, "  %-14s %12llu %10.0f %10.0f %10.0f %12.0f\n", names[op], (unsigned long long)stats.count,
+                stats.p50_ns, stats.p99_ns, stats.p999_ns, stats.max_ns);
+    }
+}
+
+static inline void __memlat_report_at_exit(void)
+{
+    mem_latency_report(stderr);
+}
+
+/* Registers a single at-exit report to stderr, however many times it is called. */
+static inline void mem_latency_report_at_exit(void)
+{
+    if (!__atomic_exchange_n(&g_mem_latency.exit_registered, 1, __ATOMIC_ACQ_REL))
+        atexit(__memlat_report_at_exit);
+}
+
+#ifdef MEMLAT_REPORT_AT_EXIT
+static inline void __init_memlat_auto(void) __attribute__((constructor));
+static inline void __init_memlat_auto(void)
+{
+    mem_latency_report_at_exit();
+}
+#endif
+
+#define __MEMLAT_NOW() memlat_now()
+#define __MEMLAT_RECORD(op, start) memlat_record((op), memlat_now() - (start))
+#else
+#define __MEMLAT_NOW() ((uint64_t)0)
+#define __MEMLAT_RECORD(op, start) ((void)(start))
+#endif
+
+#endif /* L_MEMSUO_H */
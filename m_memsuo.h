@@ -31,7 +31,8 @@
  * jemalloc (for performance) and libsodium (for secure memory).
  *
  * To enable features, compile with:
- *   -DUSE_JEMALLOC -DUSE_SODIUM -DENABLE_MEM_STATS
+ *   -DUSE_JEMALLOC -DUSE_SODIUM -DENABLE_MEM_STATS -DENABLE_MEM_PROFILE
+ *   -DENABLE_MEM_LATENCY
  * jemalloc and libsodium need to be installed.
  */
 
@@ -42,6 +43,9 @@
 #include <stdio.h>
 #include <assert.h>
 #include <pthread.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <errno.h>
 #ifdef USE_JEMALLOC
 #include <jemalloc/jemalloc.h>
 #ifndef je_malloc
@@ -59,6 +63,9 @@
 #ifndef je_posix_memalign
 #define je_posix_memalign posix_memalign
 #endif
+#ifndef je_mallctl
+#define je_mallctl mallctl
+#endif
 #endif
 #ifdef USE_SODIUM
 #include <sodium.h>
@@ -69,6 +76,7 @@
 #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
 #include <stdalign.h>
 #endif
+#include "l_memsuo.h"
 
 #ifndef LOG_ERROR
 #define LOG_ERROR(fmt, ...)                                                                                            \
@@ -119,53 +127,696 @@
 #define ATOMIC_LOAD(var) __atomic_load_n(&(var), __ATOMIC_SEQ_CST)
 #define ATOMIC_STORE(var, val) __atomic_store_n(&(var), (val), __ATOMIC_SEQ_CST)
 
+/**
+ * Memory statistics (ENABLE_MEM_STATS).
+ *
+ * Counters are split into MEMSTAT_SHARDS cache-line-sized shards and each
+ * thread updates the shard it was assigned on first use, so concurrent
+ * allocations do not bounce a shared line. Reads aggregate across shards.
+ * Sizes are the allocator's usable size.
+ *
+ * Freed bytes need a usable-size lookup on every FREE, so they are only
+ * counted when MEMSTAT_FREE_BYTES is defined; frees and reallocs then
+ * subtract exactly what was added. That also enables live bytes, which are
+ * batched into a global counter every MEMSTAT_PEAK_GRANULE bytes of drift per
+ * shard and which the peak is tracked from; peak may therefore lag by up to
+ * MEMSTAT_SHARDS * MEMSTAT_PEAK_GRANULE bytes. SODIUM_MALLOC blocks only
+ * contribute to the counts, as their size is not known at free time.
+ *
+ * The counters are defined weakly below, so programs need no definition.
+ * The old g_total_alloc_bytes, g_alloc_count and g_free_count remain as
+ * read-only views summed from the shards.
+ */
 #ifdef ENABLE_MEM_STATS
+#ifndef MEMSTAT_SHARDS
+#define MEMSTAT_SHARDS 64
+#endif
+#ifndef MEMSTAT_PEAK_GRANULE
+#define MEMSTAT_PEAK_GRANULE (64 * 1024)
+#endif
+#define MEMSTAT_SIZE_BUCKETS 48
+
+#if defined(USE_JEMALLOC)
+#ifndef je_malloc_usable_size
+#define je_malloc_usable_size malloc_usable_size
+#endif
+#define __MEMSTAT_USABLE(ptr) je_malloc_usable_size(ptr)
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#define __MEMSTAT_USABLE(ptr) malloc_usable_size(ptr)
+#else
+#define __MEMSTAT_USABLE(ptr) ((void)(ptr), (size_t)0)
+#endif
+
+typedef struct MemStatShard
+{
+    size_t alloc_bytes;
+    size_t free_bytes;
+    size_t alloc_count;
+    size_t free_count;
+    int64_t pending_live;
+    size_t size_buckets[MEMSTAT_SIZE_BUCKETS];
+} __attribute__((aligned(64))) MemStatShard;
+
+typedef struct MemStats
+{
+    MemStatShard shards[MEMSTAT_SHARDS];
+    int64_t live_bytes;
+    int64_t peak_bytes;
+    unsigned next_shard;
+} MemStats;
+
+/* Aggregated view returned by mem_stats_snapshot. */
+typedef struct MemStatsSnapshot
+{
+    size_t alloc_bytes;
+    size_t free_bytes;
+    size_t alloc_count;
+    size_t free_count;
+    int64_t live_bytes;
+    int64_t peak_bytes;
+    size_t size_buckets[MEMSTAT_SIZE_BUCKETS]; /* allocations with usable size in [2^i, 2^(i+1)) */
+} MemStatsSnapshot;
+
+__attribute__((weak)) MemStats g_mem_stats;
+
+static __thread MemStatShard *__memstat_shard;
+
+static inline MemStatShard *__memstat_my_shard(void)
+{
+    MemStatShard *shard = __memstat_shard;
+    if (__builtin_expect(shard == NULL, 0))
+    {
+        unsigned idx = __atomic_fetch_add(&g_mem_stats.next_shard, 1, __ATOMIC_RELAXED);
+        shard = &g_mem_stats.shards[idx % MEMSTAT_SHARDS];
+        __memstat_shard = shard;
+    }
+    return shard;
+}
+
+static inline void __memstat_track_live(MemStatShard *shard, int64_t delta)
+{
+    int64_t pending = __atomic_add_fetch(&shard->pending_live, delta, __ATOMIC_RELAXED);
+    if (pending < MEMSTAT_PEAK_GRANULE && pending > -MEMSTAT_PEAK_GRANULE)
+        return;
+    pending = __atomic_exchange_n(&shard->pending_live, 0, __ATOMIC_RELAXED);
+    int64_t live = __atomic_add_fetch(&g_mem_stats.live_bytes, pending, __ATOMIC_RELAXED);
+    int64_t peak = __atomic_load_n(&g_mem_stats.peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&g_mem_stats.peak_bytes, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static inline void __memstat_record_alloc(size_t usable)
+{
+    MemStatShard *shard = __memstat_my_shard();
+    size_t bucket = usable ? (size_t)(63 - __builtin_clzll((unsigned long long)usable)) : 0;
+    if (bucket >= MEMSTAT_SIZE_BUCKETS)
+        bucket = MEMSTAT_SIZE_BUCKETS - 1;
+    __atomic_add_fetch(&shard->alloc_bytes, usable, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&shard->alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&shard->size_buckets[bucket], 1, __ATOMIC_RELAXED);
+#ifdef MEMSTAT_FREE_BYTES
+    __memstat_track_live(shard, (int64_t)usable);
+#endif
+}
+
+static inline void __memstat_record_free(size_t usable)
+{
+    MemStatShard *shard = __memstat_my_shard();
+    __atomic_add_fetch(&shard->free_count, 1, __ATOMIC_RELAXED);
+#ifdef MEMSTAT_FREE_BYTES
+    __atomic_add_fetch(&shard->free_bytes, usable, __ATOMIC_RELAXED);
+    __memstat_track_live(shard, -(int64_t)usable);
+#else
+    (void)usable;
+#endif
+}
+
+/* An in-place resize moves bytes only; the allocation and its count stay as they were. */
+static inline void __memstat_record_resize(size_t old_usable, size_t new_usable)
+{
+    MemStatShard *shard = __memstat_my_shard();
+    if (new_usable > old_usable)
+    {
+        __atomic_add_fetch(&shard->alloc_bytes, new_usable - old_usable, __ATOMIC_RELAXED);
+#ifdef MEMSTAT_FREE_BYTES
+        __memstat_track_live(shard, (int64_t)(new_usable - old_usable));
+#endif
+    }
+#ifdef MEMSTAT_FREE_BYTES
+    else if (new_usable < old_usable)
+    {
+        __atomic_add_fetch(&shard->free_bytes, old_usable - new_usable, __ATOMIC_RELAXED);
+        __memstat_track_live(shard, -(int64_t)(old_usable - new_usable));
+    }
+#endif
+}
+
+static inline void __memstat_record_secure(int is_free)
+{
+    MemStatShard *shard = __memstat_my_shard();
+    __atomic_add_fetch(is_free ? &shard->free_count : &shard->alloc_count, 1, __ATOMIC_RELAXED);
+}
+
+static inline void mem_stats_snapshot(MemStatsSnapshot *out)
+{
+    int64_t pending = 0;
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < MEMSTAT_SHARDS; i++)
+    {
+        MemStatShard *shard = &g_mem_stats.shards[i];
+        out->alloc_bytes += __atomic_load_n(&shard->alloc_bytes, __ATOMIC_RELAXED);
+        out->free_bytes += __atomic_load_n(&shard->free_bytes, __ATOMIC_RELAXED);
+        out->alloc_count += __atomic_load_n(&shard->alloc_count, __ATOMIC_RELAXED);
+        out->free_count += __atomic_load_n(&shard->free_count, __ATOMIC_RELAXED);
+        pending += __atomic_load_n(&shard->pending_live, __ATOMIC_RELAXED);
+        for (int b = 0; b < MEMSTAT_SIZE_BUCKETS; b++)
+            out->size_buckets[b] += __atomic_load_n(&shard->size_buckets[b], __ATOMIC_RELAXED);
+    }
+    out->live_bytes = __atomic_load_n(&g_mem_stats.live_bytes, __ATOMIC_RELAXED) + pending;
+    out->peak_bytes = __atomic_load_n(&g_mem_stats.peak_bytes, __ATOMIC_RELAXED);
+    if (out->live_bytes > out->peak_bytes)
+        out->peak_bytes = out->live_bytes;
+}
+
+static inline void mem_stats_print(FILE *out)
+{
+    MemStatsSnapshot snap;
+    mem_stats_snapshot(&snap);
+    fprintf(out, "Memory stats:\n");
+    fprintf(out, "  Total allocated bytes: %zu\n", snap.alloc_bytes);
+    fprintf(out, "  Total freed bytes: %zu\n", snap.free_bytes);
+    fprintf(out, "  Allocation count: %zu\n", snap.alloc_count);
+    fprintf(out, "  Free count: %zu\n", snap.free_count);
+#ifdef MEMSTAT_FREE_BYTES
+    fprintf(out, "  Live bytes: %lld\n", (long long)snap.live_bytes);
+    fprintf(out, "  Peak bytes: %lld\n", (long long)snap.peak_bytes);
+#endif
+    for (int b = 0; b < MEMSTAT_SIZE_BUCKETS; b++)
+    {
+        if (snap.size_buckets[b])
+            fprintf(out, "  Size [%zu, %zu): %zu\n", (size_t)1 << b, (size_t)1 << (b + 1), snap.size_buckets[b]);
+    }
+}
+
+/* Sums one size_t counter across the shards; `field` is its offset in MemStatShard. */
+static inline size_t __memstat_sum(size_t field)
+{
+    size_t total = 0;
+    for (int i = 0; i < MEMSTAT_SHARDS; i++)
+        total += __atomic_load_n((size_t *)((char *)&g_mem_stats.shards[i] + field), __ATOMIC_RELAXED);
+    return total;
+}
+
+static inline size_t mem_stats_total_alloc_bytes(void)
+{
+    return __memstat_sum(offsetof(MemStatShard, alloc_bytes));
+}
+
+static inline size_t mem_stats_alloc_count(void)
+{
+    return __memstat_sum(offsetof(MemStatShard, alloc_count));
+}
+
+static inline size_t mem_stats_free_count(void)
+{
+    return __memstat_sum(offsetof(MemStatShard, free_count));
+}
+
+/*
+ * The pre-sharding counters, kept for old readers. In C each name is a const
+ * lvalue, so ATOMIC_LOAD(g_alloc_count) still compiles; C++ declared them as
+ * std::atomic, so there they offer load() and a conversion instead.
+ */
 #ifdef __cplusplus
-extern std::atomic<size_t> g_total_alloc_bytes;
-extern std::atomic<size_t> g_alloc_count;
-extern std::atomic<size_t> g_free_count;
+struct MemStatLegacyCounter
+{
+    size_t (*read)(void);
+    size_t load() const
+    {
+        return read();
+    }
+    operator size_t() const
+    {
+        return read();
+    }
+};
+static const MemStatLegacyCounter g_total_alloc_bytes = {mem_stats_total_alloc_bytes};
+static const MemStatLegacyCounter g_alloc_count = {mem_stats_alloc_count};
+static const MemStatLegacyCounter g_free_count = {mem_stats_free_count};
 #else
-extern _Atomic size_t g_total_alloc_bytes;
-extern _Atomic size_t g_alloc_count;
-extern _Atomic size_t g_free_count;
+#define g_total_alloc_bytes ((const size_t){mem_stats_total_alloc_bytes()})
+#define g_alloc_count ((const size_t){mem_stats_alloc_count()})
+#define g_free_count ((const size_t){mem_stats_free_count()})
+#endif
+
+#define __MEMSTAT_ALLOC(ptr)                                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (ptr)                                                                                                       \
+            __memstat_record_alloc(__MEMSTAT_USABLE(ptr));                                                             \
+    } while (0)
+#ifdef MEMSTAT_FREE_BYTES
+#define __MEMSTAT_FREE(ptr) __memstat_record_free(__MEMSTAT_USABLE(ptr))
+#define __MEMSTAT_USABLE_OR_ZERO(ptr) ((ptr) ? __MEMSTAT_USABLE(ptr) : (size_t)0)
+#else
+#define __MEMSTAT_FREE(ptr) ((void)(ptr), __memstat_record_free(0))
+#define __MEMSTAT_USABLE_OR_ZERO(ptr) ((void)(ptr), (size_t)0)
+#endif
+#define __MEMSTAT_REALLOC(oldp, oldsz, newp)                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (oldp)                                                                                                      \
+            __memstat_record_free(oldsz);                                                                              \
+        __MEMSTAT_ALLOC(newp);                                                                                         \
+    } while (0)
+#define __MEMSTAT_RESIZE(oldsz, newsz) __memstat_record_resize((oldsz), (newsz))
+#define __MEMSTAT_SECURE_ALLOC(sz) ((void)(sz), __memstat_record_secure(0))
+#define __MEMSTAT_SECURE_FREE() __memstat_record_secure(1)
+#else
+#define __MEMSTAT_ALLOC(ptr) ((void)0)
+#define __MEMSTAT_FREE(ptr) ((void)0)
+#define __MEMSTAT_USABLE_OR_ZERO(ptr) ((size_t)0)
+#define __MEMSTAT_REALLOC(oldp, oldsz, newp) ((void)(oldsz))
+#define __MEMSTAT_RESIZE(oldsz, newsz) ((void)(oldsz), (void)(newsz))
+#define __MEMSTAT_SECURE_ALLOC(sz) ((void)0)
+#define __MEMSTAT_SECURE_FREE() ((void)0)
+#endif
+
+/**
+ * Sampling heap profiler (ENABLE_MEM_PROFILE).
+ *
+ * Each thread counts down a randomized byte budget with mean
+ * MEMPROF_SAMPLE_BYTES; the allocation that crosses it is sampled, so on
+ * average one allocation per MEMPROF_SAMPLE_BYTES allocated bytes is
+ * recorded, independent of allocation sizes. A sample records the call site
+ * the MALLOC-family macro expanded at (and, with MEMPROF_STACK_DEPTH > 0, a
+ * backtrace) and carries a weight estimating the bytes it stands for.
+ * Sampled pointers stay in a live table until freed, so sites can be ranked
+ * by estimated live and cumulative bytes. FREE only takes the profiler lock
+ * when a counting filter says the pointer may have been sampled.
+ *
+ * All tables are fixed size and the profiler never allocates. Its state is
+ * defined weakly below, so programs need no definition of their own.
+ * Define MEMPROF_DUMP_AT_EXIT to print the top sites to stderr at exit.
+ */
+#ifdef ENABLE_MEM_PROFILE
+#ifndef MEMPROF_SAMPLE_BYTES
+#define MEMPROF_SAMPLE_BYTES (512 * 1024)
+#endif
+/* Both table sizes must be powers of two. */
+#ifndef MEMPROF_MAX_SITES
+#define MEMPROF_MAX_SITES 4096
+#endif
+#ifndef MEMPROF_MAX_LIVE
+#define MEMPROF_MAX_LIVE 65536
+#endif
+#ifndef MEMPROF_STACK_DEPTH
+#define MEMPROF_STACK_DEPTH 0
+#endif
+#ifndef MEMPROF_DUMP_TOP
+#define MEMPROF_DUMP_TOP 20
+#endif
+#define MEMPROF_FILTER_SIZE 65536
+#if MEMPROF_STACK_DEPTH > 0
+#include <execinfo.h>
+#define __MEMPROF_STACK_SLOTS MEMPROF_STACK_DEPTH
+#else
+#define __MEMPROF_STACK_SLOTS 1
+#endif
+
+typedef struct MemProfSite
+{
+    const char *file; /* NULL marks an empty slot */
+    int line;
+    int stack_depth;
+    uint64_t stack_hash;
+    void *stack[__MEMPROF_STACK_SLOTS];
+    size_t live_bytes;
+    size_t total_bytes;
+    size_t live_samples;
+    size_t total_samples;
+} MemProfSite;
+
+typedef struct MemProfSample
+{
+    void *ptr; /* NULL marks an empty slot */
+    uint32_t site;
+    size_t weight;
+} MemProfSample;
+
+typedef struct MemProfile
+{
+    int lock;
+    int exit_registered;
+    size_t sample_bytes; /* 0 selects MEMPROF_SAMPLE_BYTES */
+    size_t dropped;
+    size_t live_count;
+    MemProfSite sites[MEMPROF_MAX_SITES];
+    MemProfSample live[MEMPROF_MAX_LIVE];
+    unsigned char filter[MEMPROF_FILTER_SIZE];
+} MemProfile;
+
+__attribute__((weak)) MemProfile g_mem_profile;
+
+static __thread int64_t __memprof_countdown;
+static __thread uint64_t __memprof_rng;
+static __thread int __memprof_ready;
+
+static inline void __memprof_lock(void)
+{
+    while (__atomic_exchange_n(&g_mem_profile.lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&g_mem_profile.lock, __ATOMIC_RELAXED))
+            ;
+    }
+}
+
+static inline void __memprof_unlock(void)
+{
+    __atomic_store_n(&g_mem_profile.lock, 0, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t __memprof_hash_ptr(const void *ptr)
+{
+    return ((uint64_t)(uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ull;
+}
+
+/* Natural log without libm: split off the exponent, then an atanh series. */
+static inline double __memprof_ln(double x)
+{
+    union
+    {
+        double d;
+        uint64_t u;
+    } v = {x};
+    int exp2 = (int)((v.u >> 52) & 0x7ff) - 1023;
+    v.u = (v.u & 0x000fffffffffffffull) | 0x3ff0000000000000ull;
+    double z = (v.d - 1.0) / (v.d + 1.0), z2 = z * z;
+    double series = z * (2.0 + z2 * (2.0 / 3.0 + z2 * (2.0 / 5.0 + z2 * (2.0 / 7.0 + z2 * (2.0 / 9.0)))));
+    return exp2 * 0.6931471805599453 + series;
+}
+
+/* e^-x for x >= 0 by halving into Taylor range and squaring back. */
+static inline double __memprof_exp_neg(double x)
+{
+    if (x > 40.0)
+        return 0.0;
+    int squarings = 0;
+    while (x > 0.125)
+    {
+        x *= 0.5;
+        squarings++;
+    }
+    double e = 1.0 - x * (1.0 - x * (0.5 - x * (1.0 / 6.0 - x / 24.0)));
+    while (squarings--)
+        e *= e;
+    return e;
+}
+
+/* Draws the next exponentially distributed byte budget. */
+static inline int64_t __memprof_next_budget(void)
+{
+    if (!__memprof_rng)
+        __memprof_rng = __memprof_hash_ptr(&__memprof_rng) | 1;
+    __memprof_rng ^= __memprof_rng << 13;
+    __memprof_rng ^= __memprof_rng >> 7;
+    __memprof_rng ^= __memprof_rng << 17;
+    double u = ((double)(__memprof_rng >> 11) + 1.0) / 9007199254740993.0;
+    size_t mean = g_mem_profile.sample_bytes ? g_mem_profile.sample_bytes : MEMPROF_SAMPLE_BYTES;
+    return (int64_t)(-__memprof_ln(u) * (double)mean) + 1;
+}
+
+static inline uint32_t __memprof_site(const char *file, int line, void **stack, int depth)
+{
+    uint64_t stack_hash = 0;
+    for (int i = 0; i < depth; i++)
+        stack_hash = (stack_hash ^ __memprof_hash_ptr(stack[i])) * 0x100000001B3ull;
+    uint64_t h = (__memprof_hash_ptr(file) ^ (uint64_t)line * 0xC2B2AE3D27D4EB4Full) ^ stack_hash;
+    for (uint32_t probe = 0; probe < MEMPROF_MAX_SITES; probe++)
+    {
+        uint32_t idx = (uint32_t)((h + probe) & (MEMPROF_MAX_SITES - 1));
+        MemProfSite *site = &g_mem_profile.sites[idx];
+        if (!site->file)
+        {
+            site->file = file;
+            site->line = line;
+            site->stack_hash = stack_hash;
+            site->stack_depth = depth;
+            for (int i = 0; i < depth; i++)
+                site->stack[i] = stack[i];
+            return idx;
+        }
+        if (site->file == file && site->line == line && site->stack_hash == stack_hash)
+            return idx;
+    }
+    return UINT32_MAX;
+}
+
+static __attribute__((noinline)) void __memprof_sample(void *ptr, size_t size, const char *file, int line)
+{
+    if (!__memprof_ready)
+    {
+        /* First allocation on this thread: draw a budget instead of sampling. */
+        __memprof_ready = 1;
+        __memprof_countdown = __memprof_next_budget() - (int64_t)size;
+        if (__memprof_countdown > 0)
+            return;
+    }
+    __memprof_countdown = __memprof_next_budget();
+
+    size_t mean = g_mem_profile.sample_bytes ? g_mem_profile.sample_bytes : MEMPROF_SAMPLE_BYTES;
+    double p = 1.0 - __memprof_exp_neg((double)size / (double)mean);
+    size_t weight = p > 0.0 ? (size_t)((double)size / p) : mean;
+
+    void *stack[__MEMPROF_STACK_SLOTS];
+    int depth = 0;
+#if MEMPROF_STACK_DEPTH > 0
+    depth = backtrace(stack, MEMPROF_STACK_DEPTH);
+#endif
+
+    __memprof_lock();
+    uint32_t site_idx = __memprof_site(file, line, stack, depth);
+    if (site_idx == UINT32_MAX || g_mem_profile.live_count >= MEMPROF_MAX_LIVE * 3 / 4)
+    {
+        g_mem_profile.dropped++;
+        __memprof_unlock();
+        return;
+    }
+    MemProfSite *site = &g_mem_profile.sites[site_idx];
+    site->live_bytes += weight;
+    site->total_bytes += weight;
+    site->live_samples++;
+    site->total_samples++;
+    uint64_t h = __memprof_hash_ptr(ptr);
+    size_t idx = (size_t)(h >> 32) & (MEMPROF_MAX_LIVE - 1);
+    while (g_mem_profile.live[idx].ptr)
+        idx = (idx + 1) & (MEMPROF_MAX_LIVE - 1);
+    g_mem_profile.live[idx].ptr = ptr;
+    g_mem_profile.live[idx].site = site_idx;
+    g_mem_profile.live[idx].weight = weight;
+    g_mem_profile.live_count++;
+    unsigned char *slot = &g_mem_profile.filter[(h >> 48) & (MEMPROF_FILTER_SIZE - 1)];
+    if (*slot < UCHAR_MAX)
+        __atomic_store_n(slot, (unsigned char)(*slot + 1), __ATOMIC_RELAXED);
+    __memprof_unlock();
+}
+
+/* Removes a sampled pointer, backward-shifting the linear-probe cluster. */
+static __attribute__((noinline)) void __memprof_untrack(void *ptr)
+{
+    uint64_t h = __memprof_hash_ptr(ptr);
+    size_t mask = MEMPROF_MAX_LIVE - 1;
+    __memprof_lock();
+    size_t idx = (size_t)(h >> 32) & mask;
+    while (g_mem_profile.live[idx].ptr && g_mem_profile.live[idx].ptr != ptr)
+        idx = (idx + 1) & mask;
+    if (!g_mem_profile.live[idx].ptr)
+    {
+        __memprof_unlock();
+        return;
+    }
+    MemProfSite *site = &g_mem_profile.sites[g_mem_profile.live[idx].site];
+    site->live_bytes -= g_mem_profile.live[idx].weight;
+    site->live_samples--;
+    g_mem_profile.live_count--;
+    unsigned char *slot = &g_mem_profile.filter[(h >> 48) & (MEMPROF_FILTER_SIZE - 1)];
+    if (*slot < UCHAR_MAX)
+        __atomic_store_n(slot, (unsigned char)(*slot - 1), __ATOMIC_RELAXED);
+    size_t hole = idx;
+    for (size_t next = (hole + 1) & mask; g_mem_profile.live[next].ptr; next = (next + 1) & mask)
+    {
+        size_t home = (size_t)(__memprof_hash_ptr(g_mem_profile.live[next].ptr) >> 32) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            g_mem_profile.live[hole] = g_mem_profile.live[next];
+            hole = next;
+        }
+    }
+    g_mem_profile.live[hole].ptr = NULL;
+    __memprof_unlock();
+}
+
+static inline void __memprof_on_alloc(void *ptr, size_t size, const char *file, int line)
+{
+    if (!ptr)
+        return;
+    __memprof_countdown -= (int64_t)size;
+    if (__builtin_expect(__memprof_countdown <= 0, 0))
+        __memprof_sample(ptr, size, file, line);
+}
+
+/* Takes the freed address as an integer so REALLOC can pass it after the call. */
+static inline void __memprof_on_free(uintptr_t addr)
+{
+    uint64_t h = __memprof_hash_ptr((const void *)addr);
+    if (__builtin_expect(__atomic_load_n(&g_mem_profile.filter[(h >> 48) & (MEMPROF_FILTER_SIZE - 1)], __ATOMIC_RELAXED), 0))
+        __memprof_untrack((void *)addr);
+}
+
+/*
+ * An in-place resize charges only its growth to the sampling budget. A
+ * resize that crosses the budget resamples the pointer at its new size,
+ * dropping any earlier sample of it first so it is never tracked twice.
+ */
+static inline void __memprof_on_resize(void *ptr, size_t old_size, size_t new_size, const char *file, int line)
+{
+    if (new_size <= old_size)
+        return;
+    __memprof_countdown -= (int64_t)(new_size - old_size);
+    if (__builtin_expect(__memprof_countdown <= 0, 0))
+    {
+        __memprof_on_free((uintptr_t)ptr);
+        __memprof_sample(ptr, new_size, file, line);
+    }
+}
+
+/*
+ * Changes the mean sampling interval. The calling thread redraws its budget
+ * immediately; other threads pick the new rate up at their next sample.
+ */
+static inline void mem_profile_set_rate(size_t sample_bytes)
+{
+    g_mem_profile.sample_bytes = sample_bytes;
+    __memprof_ready = 0;
+    __memprof_countdown = 0;
+}
+
+static inline void __memprof_print_top(FILE *out, const char *title, int by_live, size_t top_n)
+{
+    uint32_t top[64];
+    size_t count = 0;
+    if (top_n > 64)
+        top_n = 64;
+    for (uint32_t i = 0; i < MEMPROF_MAX_SITES; i++)
+    {
+        const MemProfSite *site = &g_mem_profile.sites[i];
+        size_t key = by_live ? site->live_bytes : site->total_bytes;
+        if (!site->file || key == 0)
+            continue;
+        size_t pos = count < top_n ? count++ : top_n;
+        while (pos > 0)
+        {
+            const MemProfSite *prev = &g_mem_profile.sites[top[pos - 1]];
+            if ((by_live ? prev->live_bytes : prev->total_bytes) >= key)
+                break;
+            if (pos < top_n)
+                top[pos] = top[pos - 1];
+            pos--;
+        }
+        if (pos < top_n)
+            top[pos] = i;
+    }
+    fprintf(out, "%s\n", title);
+    for (size_t i = 0; i < count; i++)
+    {
+        const MemProfSite *site = &g_mem_profile.sites[top[i]];
+        fprintf(out, "  %12zu bytes %8zu samples  %s:%d\n", by_live ? site->live_bytes : site->total_bytes,
+                by_live ? site->live_samples : site->total_samples, site->file, site->line);
+        for (int d = 0; d < site->stack_depth; d++)
+            fprintf(out, "      #%d %p\n", d, site->stack[d]);
+    }
+}
+
+/* Prints the top `top_n` (at most 64) sites by estimated live and cumulative bytes. */
+static inline void mem_profile_dump(FILE *out, size_t top_n)
+{
+    __memprof_lock();
+    fprintf(out, "Heap profile (1 sample per ~%zu bytes, %zu live samples, %zu dropped):\n",
+            g_mem_profile.sample_bytes ? g_mem_profile.sample_bytes : (size_t)MEMPROF_SAMPLE_BYTES,
+            g_mem_profile.live_count, g_mem_profile.dropped);
+    __memprof_print_top(out, " Top sites by live bytes:", 1, top_n);
+    __memprof_print_top(out, " Top sites by cumulative bytes:", 0, top_n);
+    __memprof_unlock();
+}
+
+static inline void __memprof_dump_at_exit(void)
+{
+    mem_profile_dump(stderr, MEMPROF_DUMP_TOP);
+}
+
+/* Registers a single at-exit dump to stderr, however many times it is called. */
+static inline void mem_profile_dump_at_exit(void)
+{
+    if (!__atomic_exchange_n(&g_mem_profile.exit_registered, 1, __ATOMIC_ACQ_REL))
+        atexit(__memprof_dump_at_exit);
+}
+
+#ifdef MEMPROF_DUMP_AT_EXIT
+static inline void __init_memprof_auto(void) __attribute__((constructor));
+static inline void __init_memprof_auto(void)
+{
+    mem_profile_dump_at_exit();
+}
 #endif
-#define __MEMSTAT_ADD_BYTES(sz) __atomic_add_fetch(&g_total_alloc_bytes, (sz), __ATOMIC_RELAXED)
-#define __MEMSTAT_INC_ALLOC() __atomic_add_fetch(&g_alloc_count, 1, __ATOMIC_RELAXED)
-#define __MEMSTAT_INC_FREE() __atomic_add_fetch(&g_free_count, 1, __ATOMIC_RELAXED)
+
+#define __MEMPROF_ALLOC(ptr, size) __memprof_on_alloc((ptr), (size), __FILE__, __LINE__)
+#define __MEMPROF_FREE(ptr) __memprof_on_free((uintptr_t)(ptr))
+#define __MEMPROF_RESIZE(ptr, oldsz, newsz) __memprof_on_resize((ptr), (oldsz), (newsz), __FILE__, __LINE__)
 #else
-#define __MEMSTAT_ADD_BYTES(sz) ((void)0)
-#define __MEMSTAT_INC_ALLOC() ((void)0)
-#define __MEMSTAT_INC_FREE() ((void)0)
+#define __MEMPROF_ALLOC(ptr, size) ((void)0)
+#define __MEMPROF_FREE(ptr) ((void)0)
+#define __MEMPROF_RESIZE(ptr, oldsz, newsz) ((void)(oldsz), (void)(newsz))
 #endif
 
+/*
+ * REALLOC and RALLOCX drop the old block's profile sample before the call, so
+ * the old pointer is never read once it may have been freed. If the call fails,
+ * that sample is lost and the block goes unprofiled until it is freed.
+ */
 #if defined(USE_JEMALLOC)
 #define MALLOC(size)                                                                                                   \
     (__extension__({                                                                                                   \
         size_t _msz = (size);                                                                                          \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
         void *_mptr = je_malloc(_msz);                                                                                 \
+        __MEMLAT_RECORD(MEMLAT_MALLOC, _lt);                                                                           \
         if (!_mptr && _msz != 0)                                                                                       \
         {                                                                                                              \
             LOG_ERROR("%s", "je_malloc failed");                                                                       \
         }                                                                                                              \
         else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_ADD_BYTES(_msz);                                                                                 \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
+            __MEMSTAT_ALLOC(_mptr);                                                                                    \
+            __MEMPROF_ALLOC(_mptr, _msz);                                                                              \
         }                                                                                                              \
         _mptr;                                                                                                         \
     }))
 #define CALLOC(n, sz)                                                                                                  \
     (__extension__({                                                                                                   \
         size_t _cnt = (n), _sz = (sz);                                                                                 \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
         void *_mptr = je_calloc(_cnt, _sz);                                                                            \
+        __MEMLAT_RECORD(MEMLAT_CALLOC, _lt);                                                                           \
         if (!_mptr && (_cnt * _sz) != 0)                                                                               \
         {                                                                                                              \
             LOG_ERROR("%s", "je_calloc failed");                                                                       \
         }                                                                                                              \
         else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_ADD_BYTES(_cnt *_sz);                                                                            \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
+            __MEMSTAT_ALLOC(_mptr);                                                                                    \
+            __MEMPROF_ALLOC(_mptr, _cnt * _sz);                                                                        \
         }                                                                                                              \
         _mptr;                                                                                                         \
     }))
@@ -173,15 +824,19 @@ extern _Atomic size_t g_free_count;
     (__extension__({                                                                                                   \
         void *_oldp = (ptr);                                                                                           \
         size_t _newsz = (new_size);                                                                                    \
+        size_t _oldsz = __MEMSTAT_USABLE_OR_ZERO(_oldp);                                                               \
+        __MEMPROF_FREE(_oldp);                                                                                         \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
         void *_mptr = je_realloc(_oldp, _newsz);                                                                       \
+        __MEMLAT_RECORD(MEMLAT_REALLOC, _lt);                                                                          \
         if (!_mptr && _newsz != 0)                                                                                     \
         {                                                                                                              \
             LOG_ERROR("%s", "je_realloc failed");                                                                      \
         }                                                                                                              \
-        else if (_mptr)                                                                                                \
+        else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
-            __MEMSTAT_INC_FREE();                                                                                      \
+            __MEMSTAT_REALLOC(_oldp, _oldsz, _mptr);                                                                   \
+            __MEMPROF_ALLOC(_mptr, _newsz);                                                                            \
         }                                                                                                              \
         _mptr;                                                                                                         \
     }))
@@ -191,8 +846,11 @@ extern _Atomic size_t g_free_count;
         void *_fptr = (ptr);                                                                                           \
         if (_fptr)                                                                                                     \
         {                                                                                                              \
-            __MEMSTAT_INC_FREE();                                                                                      \
+            __MEMSTAT_FREE(_fptr);                                                                                     \
+            __MEMPROF_FREE(_fptr);                                                                                     \
+            uint64_t _lt = __MEMLAT_NOW();                                                                             \
             je_free(_fptr);                                                                                            \
+            __MEMLAT_RECORD(MEMLAT_FREE, _lt);                                                                         \
         }                                                                                                              \
     } while (0)
 #define ALIGNED_ALLOC(align, size)                                                                                     \
@@ -200,7 +858,10 @@ extern _Atomic size_t g_free_count;
         void *_aptr = NULL;                                                                                            \
         size_t _asz = (size);                                                                                          \
         size_t _align = (align);                                                                                       \
-        if (je_posix_memalign(&_aptr, _align, _asz) != 0)                                                              \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
+        int _arc = je_posix_memalign(&_aptr, _align, _asz);                                                            \
+        __MEMLAT_RECORD(MEMLAT_ALIGNED_ALLOC, _lt);                                                                    \
+        if (_arc != 0)                                                                                                 \
         {                                                                                                              \
             _aptr = NULL;                                                                                              \
         }                                                                                                              \
@@ -210,8 +871,8 @@ extern _Atomic size_t g_free_count;
         }                                                                                                              \
         else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_ADD_BYTES(_asz);                                                                                 \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
+            __MEMSTAT_ALLOC(_aptr);                                                                                    \
+            __MEMPROF_ALLOC(_aptr, _asz);                                                                              \
         }                                                                                                              \
         _aptr;                                                                                                         \
     }))
@@ -219,30 +880,34 @@ extern _Atomic size_t g_free_count;
 #define MALLOC(size)                                                                                                   \
     (__extension__({                                                                                                   \
         size_t _msz = (size);                                                                                          \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
         void *_mptr = malloc(_msz);                                                                                    \
+        __MEMLAT_RECORD(MEMLAT_MALLOC, _lt);                                                                           \
         if (!_mptr && _msz != 0)                                                                                       \
         {                                                                                                              \
             LOG_ERROR("%s", "malloc failed");                                                                          \
         }                                                                                                              \
         else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_ADD_BYTES(_msz);                                                                                 \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
+            __MEMSTAT_ALLOC(_mptr);                                                                                    \
+            __MEMPROF_ALLOC(_mptr, _msz);                                                                              \
         }                                                                                                              \
         _mptr;                                                                                                         \
     }))
 #define CALLOC(n, sz)                                                                                                  \
     (__extension__({                                                                                                   \
         size_t _cnt = (n), _sz = (sz);                                                                                 \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
         void *_mptr = calloc(_cnt, _sz);                                                                               \
+        __MEMLAT_RECORD(MEMLAT_CALLOC, _lt);                                                                           \
         if (!_mptr && (_cnt * _sz) != 0)                                                                               \
         {                                                                                                              \
             LOG_ERROR("%s", "calloc failed");                                                                          \
         }                                                                                                              \
         else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_ADD_BYTES(_cnt *_sz);                                                                            \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
+            __MEMSTAT_ALLOC(_mptr);                                                                                    \
+            __MEMPROF_ALLOC(_mptr, _cnt * _sz);                                                                        \
         }                                                                                                              \
         _mptr;                                                                                                         \
     }))
@@ -250,15 +915,19 @@ extern _Atomic size_t g_free_count;
     (__extension__({                                                                                                   \
         void *_oldp = (ptr);                                                                                           \
         size_t _newsz = (new_size);                                                                                    \
+        size_t _oldsz = __MEMSTAT_USABLE_OR_ZERO(_oldp);                                                               \
+        __MEMPROF_FREE(_oldp);                                                                                         \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
         void *_mptr = realloc(_oldp, _newsz);                                                                          \
+        __MEMLAT_RECORD(MEMLAT_REALLOC, _lt);                                                                          \
         if (!_mptr && _newsz != 0)                                                                                     \
         {                                                                                                              \
             LOG_ERROR("%s", "realloc failed");                                                                         \
         }                                                                                                              \
-        else if (_mptr)                                                                                                \
+        else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
-            __MEMSTAT_INC_FREE();                                                                                      \
+            __MEMSTAT_REALLOC(_oldp, _oldsz, _mptr);                                                                   \
+            __MEMPROF_ALLOC(_mptr, _newsz);                                                                            \
         }                                                                                                              \
         _mptr;                                                                                                         \
     }))
@@ -268,8 +937,11 @@ extern _Atomic size_t g_free_count;
         void *_fptr = (ptr);                                                                                           \
         if (_fptr)                                                                                                     \
         {                                                                                                              \
-            __MEMSTAT_INC_FREE();                                                                                      \
+            __MEMSTAT_FREE(_fptr);                                                                                     \
+            __MEMPROF_FREE(_fptr);                                                                                     \
+            uint64_t _lt = __MEMLAT_NOW();                                                                             \
             free(_fptr);                                                                                               \
+            __MEMLAT_RECORD(MEMLAT_FREE, _lt);                                                                         \
         }                                                                                                              \
     } while (0)
 #define ALIGNED_ALLOC(align, size)                                                                                     \
@@ -277,7 +949,10 @@ extern _Atomic size_t g_free_count;
         void *_aptr = NULL;                                                                                            \
         size_t _asz = (size);                                                                                          \
         size_t _align = (align);                                                                                       \
-        if (posix_memalign(&_aptr, _align, _asz) != 0)                                                                 \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
+        int _arc = posix_memalign(&_aptr, _align, _asz);                                                               \
+        __MEMLAT_RECORD(MEMLAT_ALIGNED_ALLOC, _lt);                                                                    \
+        if (_arc != 0)                                                                                                 \
         {                                                                                                              \
             _aptr = NULL;                                                                                              \
         }                                                                                                              \
@@ -287,26 +962,338 @@ extern _Atomic size_t g_free_count;
         }                                                                                                              \
         else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_ADD_BYTES(_asz);                                                                                 \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
+            __MEMSTAT_ALLOC(_aptr);                                                                                    \
+            __MEMPROF_ALLOC(_aptr, _asz);                                                                              \
         }                                                                                                              \
         _aptr;                                                                                                         \
     }))
 #endif
 
+/**
+ * Extended allocation API, modelled on jemalloc's *allocx family.
+ *
+ * MALLOCX(size, flags) and RALLOCX(ptr, size, flags) take MALLOCX_ALIGN(a),
+ * MALLOCX_ZERO, MALLOCX_ARENA(a) and MALLOCX_TCACHE(tc) / MALLOCX_TCACHE_NONE
+ * flags. XALLOCX(ptr, size, extra, flags) tries to resize in place to at
+ * least size (and up to size + extra) bytes and returns the resulting usable
+ * size; the pointer never moves, so a result below size means the grow
+ * failed. SDALLOCX(ptr, size, flags) / SIZED_FREE(ptr, size) free with the
+ * size the caller already knows, which lets jemalloc skip the size-class
+ * lookup; size must lie between the requested and the usable size and flags
+ * must carry the alignment the block was allocated with. NALLOCX(size, flags)
+ * returns the usable size a request would get. As with mallocx, size must not
+ * be zero.
+ *
+ * mem_je_arena_create() makes a dedicated jemalloc arena, so a subsystem can
+ * route its allocations there with MALLOCX_ARENA or bind a thread to it with
+ * mem_je_thread_arena() and keep its fragmentation away from the rest of the
+ * heap. The mem_je_tcache_* functions create, flush and destroy explicit
+ * thread caches and toggle or flush the calling thread's own. They return 0
+ * or an errno value.
+ *
+ * Without USE_JEMALLOC the macros fall back to libc: alignment goes through
+ * posix_memalign, zeroing through calloc or memset, XALLOCX only reports the
+ * current usable size, arena and tcache flags are ignored and the control
+ * functions return ENOSYS. Zeroing the grown tail in RALLOCX needs
+ * malloc_usable_size, so it is only honoured on glibc.
+ */
+#if defined(USE_JEMALLOC)
+#ifndef je_mallocx
+#define je_mallocx mallocx
+#endif
+#ifndef je_rallocx
+#define je_rallocx rallocx
+#endif
+#ifndef je_xallocx
+#define je_xallocx xallocx
+#endif
+#ifndef je_sdallocx
+#define je_sdallocx sdallocx
+#endif
+#ifndef je_nallocx
+#define je_nallocx nallocx
+#endif
+#ifndef je_sallocx
+#define je_sallocx sallocx
+#endif
+#define __MEMX_USABLE(ptr) je_sallocx((ptr), 0)
+#define __MEMX_MALLOCX(size, flags) je_mallocx((size), (flags))
+#define __MEMX_RALLOCX(ptr, size, flags) je_rallocx((ptr), (size), (flags))
+#define __MEMX_XALLOCX(ptr, size, extra, flags) je_xallocx((ptr), (size), (extra), (flags))
+#define __MEMX_SDALLOCX(ptr, size, flags) je_sdallocx((ptr), (size), (flags))
+#define __MEMX_NALLOCX(size, flags) je_nallocx((size), (flags))
+
+static inline int mem_je_arena_create(unsigned *arena)
+{
+    size_t len = sizeof(*arena);
+    return je_mallctl("arenas.create", arena, &len, NULL, 0);
+}
+
+/* Every thread bound to the arena must have moved off it first. */
+static inline int mem_je_arena_destroy(unsigned arena)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "arena.%u.destroy", arena);
+    return je_mallctl(name, NULL, NULL, NULL, 0);
+}
+
+/* Returns the arena's dirty and muzzy pages to the kernel. */
+static inline int mem_je_arena_purge(unsigned arena)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "arena.%u.purge", arena);
+    return je_mallctl(name, NULL, NULL, NULL, 0);
+}
+
+/* Binds the calling thread to arena; the previous binding goes to *old if non-NULL. */
+static inline int mem_je_thread_arena(unsigned arena, unsigned *old)
+{
+    unsigned prev = 0;
+    size_t len = sizeof(prev);
+    int rc = je_mallctl("thread.arena", &prev, &len, &arena, sizeof(arena));
+    if (rc == 0 && old)
+        *old = prev;
+    return rc;
+}
+
+static inline int mem_je_tcache_create(unsigned *tcache)
+{
+    size_t len = sizeof(*tcache);
+    return je_mallctl("tcache.create", tcache, &len, NULL, 0);
+}
+
+static inline int mem_je_tcache_flush(unsigned tcache)
+{
+    return je_mallctl("tcache.flush", NULL, NULL, &tcache, sizeof(tcache));
+}
+
+static inline int mem_je_tcache_destroy(unsigned tcache)
+{
+    return je_mallctl("tcache.destroy", NULL, NULL, &tcache, sizeof(tcache));
+}
+
+static inline int mem_je_thread_tcache_flush(void)
+{
+    return je_mallctl("thread.tcache.flush", NULL, NULL, NULL, 0);
+}
+
+static inline int mem_je_thread_tcache_enable(int enable)
+{
+    bool on = enable != 0;
+    return je_mallctl("thread.tcache.enabled", NULL, NULL, &on, sizeof(on));
+}
+#else
+/* Same encoding as jemalloc so code written against its flags keeps working. */
+#ifndef MALLOCX_ZERO
+#define MALLOCX_LG_ALIGN(la) ((int)(la))
+#define MALLOCX_ALIGN(a) ((int)__builtin_ctzl((unsigned long)(a)))
+#define MALLOCX_ZERO ((int)0x40)
+#define MALLOCX_TCACHE(tc) ((int)(((tc) + 2) << 8))
+#define MALLOCX_TCACHE_NONE MALLOCX_TCACHE(-1)
+#define MALLOCX_ARENA(a) ((int)(((unsigned)(a) + 1) << 20))
+#endif
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define __MEMX_USABLE(ptr) malloc_usable_size(ptr)
+#else
+#define __MEMX_USABLE(ptr) ((void)(ptr), (size_t)0)
+#endif
+
+static inline size_t __memx_align(int flags)
+{
+    size_t align = (size_t)1 << (flags & 0x3f);
+    return align > __alignof__(max_align_t) ? align : 0;
+}
+
+static inline void *__memx_libc_mallocx(size_t size, int flags)
+{
+    size_t align = __memx_align(flags);
+    void *ptr = NULL;
+    if (!align)
+        return (flags & MALLOCX_ZERO) ? calloc(1, size) : malloc(size);
+    if (posix_memalign(&ptr, align, size) != 0)
+        return NULL;
+    if (flags & MALLOCX_ZERO)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+static inline void *__memx_libc_rallocx(void *ptr, size_t size, int flags)
+{
+    size_t align = __memx_align(flags);
+    size_t old = __MEMX_USABLE(ptr);
+    void *out;
+    if (!align)
+    {
+        out = realloc(ptr, size);
+    }
+    else
+    {
+        /* realloc drops the alignment, so move by hand. */
+        if (posix_memalign(&out, align, size) != 0)
+            return NULL;
+        memcpy(out, ptr, old && old < size ? old : size);
+        free(ptr);
+    }
+    if (out && (flags & MALLOCX_ZERO) && old && size > old)
+        memset((unsigned char *)out + old, 0, size - old);
+    return out;
+}
+
+static inline size_t __memx_libc_nallocx(size_t size, int flags)
+{
+    size_t align = __memx_align(flags);
+    return align ? ALIGN_UP(size, align) : size;
+}
+
+#define __MEMX_MALLOCX(size, flags) __memx_libc_mallocx((size), (flags))
+#define __MEMX_RALLOCX(ptr, size, flags) __memx_libc_rallocx((ptr), (size), (flags))
+#define __MEMX_XALLOCX(ptr, size, extra, flags) ((void)(size), (void)(extra), (void)(flags), __MEMX_USABLE(ptr))
+#define __MEMX_SDALLOCX(ptr, size, flags) ((void)(size), (void)(flags), free(ptr))
+#define __MEMX_NALLOCX(size, flags) __memx_libc_nallocx((size), (flags))
+
+static inline int mem_je_arena_create(unsigned *arena)
+{
+    *arena = 0;
+    return ENOSYS;
+}
+
+static inline int mem_je_arena_destroy(unsigned arena)
+{
+    (void)arena;
+    return ENOSYS;
+}
+
+static inline int mem_je_arena_purge(unsigned arena)
+{
+    (void)arena;
+    return ENOSYS;
+}
+
+static inline int mem_je_thread_arena(unsigned arena, unsigned *old)
+{
+    (void)arena;
+    (void)old;
+    return ENOSYS;
+}
+
+static inline int mem_je_tcache_create(unsigned *tcache)
+{
+    *tcache = 0;
+    return ENOSYS;
+}
+
+static inline int mem_je_tcache_flush(unsigned tcache)
+{
+    (void)tcache;
+    return ENOSYS;
+}
+
+static inline int mem_je_tcache_destroy(unsigned tcache)
+{
+    (void)tcache;
+    return ENOSYS;
+}
+
+static inline int mem_je_thread_tcache_flush(void)
+{
+    return ENOSYS;
+}
+
+static inline int mem_je_thread_tcache_enable(int enable)
+{
+    (void)enable;
+    return ENOSYS;
+}
+#endif
+
+/* XALLOCX records only the change in usable size, so it looks the old size up when a hook needs it. */
+#if defined(ENABLE_MEM_STATS) || defined(ENABLE_MEM_PROFILE)
+#define __MEMX_HOOK_USABLE(ptr) __MEMX_USABLE(ptr)
+#else
+#define __MEMX_HOOK_USABLE(ptr) ((void)(ptr), (size_t)0)
+#endif
+
+#define MALLOCX(size, flags)                                                                                           \
+    (__extension__({                                                                                                   \
+        size_t _msz = (size);                                                                                          \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
+        void *_mptr = __MEMX_MALLOCX(_msz, (flags));                                                                   \
+        __MEMLAT_RECORD(MEMLAT_MALLOC, _lt);                                                                           \
+        if (!_mptr)                                                                                                    \
+        {                                                                                                              \
+            LOG_ERROR("%s", "mallocx failed");                                                                         \
+        }                                                                                                              \
+        else                                                                                                           \
+        {                                                                                                              \
+            __MEMSTAT_ALLOC(_mptr);                                                                                    \
+            __MEMPROF_ALLOC(_mptr, _msz);                                                                              \
+        }                                                                                                              \
+        _mptr;                                                                                                         \
+    }))
+#define RALLOCX(ptr, new_size, flags)                                                                                  \
+    (__extension__({                                                                                                   \
+        void *_oldp = (ptr);                                                                                           \
+        size_t _newsz = (new_size);                                                                                    \
+        size_t _oldsz = __MEMSTAT_USABLE_OR_ZERO(_oldp);                                                               \
+        __MEMPROF_FREE(_oldp);                                                                                         \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
+        void *_mptr = __MEMX_RALLOCX(_oldp, _newsz, (flags));                                                          \
+        __MEMLAT_RECORD(MEMLAT_REALLOC, _lt);                                                                          \
+        if (!_mptr)                                                                                                    \
+        {                                                                                                              \
+            LOG_ERROR("%s", "rallocx failed");                                                                         \
+        }                                                                                                              \
+        else                                                                                                           \
+        {                                                                                                              \
+            __MEMSTAT_REALLOC(_oldp, _oldsz, _mptr);                                                                   \
+            __MEMPROF_ALLOC(_mptr, _newsz);                                                                            \
+        }                                                                                                              \
+        _mptr;                                                                                                         \
+    }))
+#define XALLOCX(ptr, size, extra, flags)                                                                               \
+    (__extension__({                                                                                                   \
+        void *_xptr = (ptr);                                                                                           \
+        size_t _xsz = (size);                                                                                          \
+        size_t _oldsz = __MEMX_HOOK_USABLE(_xptr);                                                                     \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
+        size_t _xres = __MEMX_XALLOCX(_xptr, _xsz, (extra), (flags));                                                  \
+        __MEMLAT_RECORD(MEMLAT_REALLOC, _lt);                                                                          \
+        __MEMSTAT_RESIZE(_oldsz, _xres);                                                                               \
+        __MEMPROF_RESIZE(_xptr, _oldsz, _xres);                                                                        \
+        _xres;                                                                                                         \
+    }))
+#define SDALLOCX(ptr, size, flags)                                                                                     \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        void *_fptr = (ptr);                                                                                           \
+        if (_fptr)                                                                                                     \
+        {                                                                                                              \
+            __MEMSTAT_FREE(_fptr);                                                                                     \
+            __MEMPROF_FREE(_fptr);                                                                                     \
+            uint64_t _lt = __MEMLAT_NOW();                                                                             \
+            __MEMX_SDALLOCX(_fptr, (size), (flags));                                                                   \
+            __MEMLAT_RECORD(MEMLAT_FREE, _lt);                                                                         \
+        }                                                                                                              \
+    } while (0)
+#define SIZED_FREE(ptr, size) SDALLOCX((ptr), (size), 0)
+#define NALLOCX(size, flags) __MEMX_NALLOCX((size), (flags))
+
 #ifdef USE_SODIUM
 #define SODIUM_MALLOC(size)                                                                                            \
     (__extension__({                                                                                                   \
         size_t _ssz = (size);                                                                                          \
+        uint64_t _lt = __MEMLAT_NOW();                                                                                 \
         void *_sptr = sodium_malloc(_ssz);                                                                             \
+        __MEMLAT_RECORD(MEMLAT_SODIUM_MALLOC, _lt);                                                                    \
         if (!_sptr && _ssz != 0)                                                                                       \
         {                                                                                                              \
             LOG_ERROR("%s", "sodium_malloc failed");                                                                   \
         }                                                                                                              \
         else                                                                                                           \
         {                                                                                                              \
-            __MEMSTAT_ADD_BYTES(_ssz);                                                                                 \
-            __MEMSTAT_INC_ALLOC();                                                                                     \
+            __MEMSTAT_SECURE_ALLOC(_ssz);                                                                              \
         }                                                                                                              \
         _sptr;                                                                                                         \
     }))
@@ -316,8 +1303,10 @@ extern _Atomic size_t g_free_count;
         void *_fsptr = (ptr);                                                                                          \
         if (_fsptr)                                                                                                    \
         {                                                                                                              \
-            __MEMSTAT_INC_FREE();                                                                                      \
+            __MEMSTAT_SECURE_FREE();                                                                                   \
+            uint64_t _lt = __MEMLAT_NOW();                                                                             \
             sodium_free(_fsptr);                                                                                       \
+            __MEMLAT_RECORD(MEMLAT_SODIUM_FREE, _lt);                                                                  \
         }                                                                                                              \
     } while (0)
 #if defined(__GNUC__) || defined(__clang__)
@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef N_MEMSUO_H
+#define N_MEMSUO_H
+
+/**
+ * NUMA placement helpers.
+ *
+ * Thin wrappers over the Linux mbind, set_mempolicy and getcpu syscalls, so
+ * no libnuma is needed. mem_numa_apply sets the policy of a page-aligned range
+ * before it is first touched; mem_numa_set_thread_policy sets the calling
+ * thread's default policy, which is what places MALLOC memory when its pages
+ * are first faulted in. Placement is advisory: on a single-node machine, on
+ * kernels built without NUMA or on other systems every call degrades to a
+ * no-op and mem_numa_current_node returns 0.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+/* Nodes at or above this are treated as node 0. */
+#ifndef MEM_NUMA_MAX_NODES
+#define MEM_NUMA_MAX_NODES 64
+#endif
+
+typedef enum MemNumaPolicy
+{
+    MEM_NUMA_DEFAULT = 0, /* leave placement to first touch */
+    MEM_NUMA_LOCAL,       /* prefer the node of the thread creating the memory */
+    MEM_NUMA_BIND,        /* only the given node */
+    MEM_NUMA_INTERLEAVE   /* page-interleaved across every online node */
+} MemNumaPolicy;
+
+/* Linux mempolicy modes and flags, from <linux/mempolicy.h>. */
+#define __MEMNUMA_MPOL_DEFAULT 0
+#define __MEMNUMA_MPOL_PREFERRED 1
+#define __MEMNUMA_MPOL_BIND 2
+#define __MEMNUMA_MPOL_INTERLEAVE 3
+#define __MEMNUMA_MPOL_LOCAL 4
+
+#define __MEMNUMA_MASK_WORDS ((MEM_NUMA_MAX_NODES + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long)))
+
+static int __memnuma_nodes;
+
+/* Number of online nodes, read once from sysfs; 1 when it cannot be read. */
+static inline int mem_numa_node_count(void)
+{
+    int nodes = __atomic_load_n(&__memnuma_nodes, __ATOMIC_RELAXED);
+    if (nodes)
+        return nodes;
+    nodes = 1;
+#ifdef __linux__
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    if (f)
+    {
+        /* The list looks like "0" or "0-1,4-5"; the last number is the highest node. */
+        int lo, hi, c;
+        while (fscanf(f, "%d", &lo) == 1)
+        {
+            hi = lo;
+            c = fgetc(f);
+            if (c == '-' && fscanf(f, "%d", &hi) == 1)
+                c = fgetc(f);
+            if (hi + 1 > nodes)
+                nodes = hi + 1;
+            if (c != ',')
+                break;
+        }
+        fclose(f);
+    }
+    if (nodes > MEM_NUMA_MAX_NODES)
+        nodes = MEM_NUMA_MAX_NODES;
+#endif
+    __atomic_store_n(&__memnuma_nodes, nodes, __ATOMIC_RELAXED);
+    return nodes;
+}
+
+/* Node of the CPU the calling thread is running on. */
+static inline int mem_numa_current_node(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    if (mem_numa_node_count() > 1)
+    {
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < MEM_NUMA_MAX_NODES)
+            return (int)node;
+    }
+#endif
+    return 0;
+}
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_set_mempolicy)
+/* Translates a policy into a kernel mode and node mask; returns the mode. */
+static inline int __memnuma_mode(MemNumaPolicy policy, int node, unsigned long *mask)
+{
+    size_t bits = 8 * sizeof(unsigned long);
+    for (size_t i = 0; i < __MEMNUMA_MASK_WORDS; i++)
+        mask[i] = 0;
+    if (node < 0 || node >= mem_numa_node_count())
+        node = 0;
+    switch (policy)
+    {
+    case MEM_NUMA_LOCAL:
+        mask[(size_t)node / bits] |= 1ul << ((size_t)node % bits);
+        return __MEMNUMA_MPOL_PREFERRED;
+    case MEM_NUMA_BIND:
+        mask[(size_t)node / bits] |= 1ul << ((size_t)node % bits);
+        return __MEMNUMA_MPOL_BIND;
+    case MEM_NUMA_INTERLEAVE:
+        for (int n = 0; n < mem_numa_node_count(); n++)
+            mask[(size_t)n / bits] |= 1ul << ((size_t)n % bits);
+        return __MEMNUMA_MPOL_INTERLEAVE;
+    default:
+        return __MEMNUMA_MPOL_DEFAULT;
+    }
+}
+#endif
+
+/*
+ * Sets the policy of [addr, addr + len), which must be page aligned. For
+ * MEM_NUMA_LOCAL, `node` is the node to prefer, normally
+ * mem_numa_current_node(). Pages already faulted in are not migrated. Returns
+ * 0 on success or when there is only one node, -1 otherwise.
+ */
+static inline int mem_numa_apply(void *addr, size_t len, MemNumaPolicy policy, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_set_mempolicy)
+    if (policy == MEM_NUMA_DEFAULT || mem_numa_node_count() < 2)
+        return 0;
+    unsigned long mask[__MEMNUMA_MASK_WORDS];
+    int mode = __memnuma_mode(policy, node, mask);
+    return syscall(SYS_mbind, addr, len, mode, mask, (unsigned long)MEM_NUMA_MAX_NODES + 1, 0u) == 0 ? 0 : -1;
+#else
+    (void)addr;
+    (void)len;
+    (void)policy;
+    (void)node;
+    return 0;
+#endif
+}
+
+/*
+ * Sets the calling thread's default policy for memory it faults in from now
+ * on, including MALLOC blocks. MEM_NUMA_LOCAL restores first-touch placement
+ * on the thread's current node. Returns 0 on success or when there is only
+ * one node, -1 otherwise.
+ */
+static inline int mem_numa_set_thread_policy(MemNumaPolicy policy, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_set_mempolicy)
+    if (mem_numa_node_count() < 2)
+        return 0;
+    unsigned long mask[__MEMNUMA_MASK_WORDS];
+    int mode = __memnuma_mode(policy, node, mask);
+    if (policy == MEM_NUMA_LOCAL)
+    {
+        if (syscall(SYS_set_mempolicy, __MEMNUMA_MPOL_LOCAL, NULL, 0ul) == 0)
+            return 0;
+        if (errno != EINVAL)
+            return -1;
+        /* Kernels before 3.8 lack MPOL_LOCAL; default placement is local too. */
+        mode = __MEMNUMA_MPOL_DEFAULT;
+    }
+    if (mode == __MEMNUMA_MPOL_DEFAULT)
+        return syscall(SYS_set_mempolicy, mode, NULL, 0ul) == 0 ? 0 : -1;
+    return syscall(SYS_set_mempolicy, mode, mask, (unsigned long)MEM_NUMA_MAX_NODES + 1) == 0 ? 0 : -1;
+#else
+    (void)policy;
+    (void)node;
+    return 0;
+#endif
+}
+
+#endif /* N_MEMSUO_H */
@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef P_MEMSUO_H
+#define P_MEMSUO_H
+
+/**
+ * Fixed-size object pools.
+ *
+ * A Pool hands out equally sized slots that can be freed one at a time.
+ * Slots are bump-allocated from an Arena, so they are densely packed in the
+ * order they were first used, and freed slots are threaded onto an intrusive
+ * free list through their first word. Allocation and free are O(1) and do
+ * no locking; a Pool must only be used by one thread at a time. Everything
+ * is released at once by pool_destroy.
+ *
+ * SizeClassAlloc extends the same idea to variable-sized objects living in a
+ * caller's Arena: requests are rounded up to one of SIZECLASS_COUNT classes
+ * (16-byte steps up to 128, then four classes per power of two up to
+ * SIZECLASS_MAX) and freed objects are recycled through per-class free lists.
+ * Frees are sized, like sdallocx, so objects carry no header. Requests above
+ * SIZECLASS_MAX come straight from the arena and are not recycled. The
+ * allocator owns no memory of its own; arena_destroy releases everything.
+ */
+
+#include "a_memsuo.h"
+
+#ifndef POOL_BLOCK_SLOTS
+#define POOL_BLOCK_SLOTS 64
+#endif
+
+#define SIZECLASS_QUANTUM 16
+#define SIZECLASS_MAX 4096
+#define SIZECLASS_COUNT 28
+
+typedef struct PoolSlot
+{
+    struct PoolSlot *next;
+} PoolSlot;
+
+typedef struct Pool
+{
+    Arena arena;
+    PoolSlot *free_list;
+    size_t slot_size;
+    size_t slot_align;
+} Pool;
+
+typedef struct SizeClassAlloc
+{
+    Arena *arena;
+    PoolSlot *free_lists[SIZECLASS_COUNT];
+} SizeClassAlloc;
+
+#define POOL_INIT(poolPtr, Type) (pool_init((poolPtr), sizeof(Type), _Alignof(Type), POOL_BLOCK_SLOTS))
+#define POOL_ALLOC(poolPtr) (pool_alloc((poolPtr), 0))
+#define POOL_ALLOC_NOZERO(poolPtr) (pool_alloc((poolPtr), ARENA_NO_ZERO))
+#define POOL_FREE(poolPtr, ptr) (pool_free((poolPtr), (ptr)))
+
+/* An overflowing size * count becomes 0, which sizeclass_alloc refuses and sizeclass_free ignores. */
+#define SIZECLASS_BYTES(Type, count) ((size_t)(count) > SIZE_MAX / sizeof(Type) ? 0 : sizeof(Type) * (size_t)(count))
+#define SIZECLASS_ALLOC(scPtr, Type, count) ((Type *)sizeclass_alloc((scPtr), SIZECLASS_BYTES(Type, count), 0))
+#define SIZECLASS_ALLOC_NOZERO(scPtr, Type, count)                                                                     \
+    ((Type *)sizeclass_alloc((scPtr), SIZECLASS_BYTES(Type, count), ARENA_NO_ZERO))
+#define SIZECLASS_FREE(scPtr, ptr, Type, count) (sizeclass_free((scPtr), (ptr), SIZECLASS_BYTES(Type, count)))
+
+#if defined(__GNUC__) || defined(__clang__)
+#define POOL_SCOPE(name, Type)                                                                                         \
+    __attribute__((cleanup(pool_destroy))) Pool name;                                                                  \
+    POOL_INIT(&(name), Type)
+#else
+#define POOL_SCOPE(name, Type)                                                                                         \
+    Pool name;                                                                                                         \
+    POOL_INIT(&(name), Type)
+#endif
+
+static inline int pool_init(Pool *pool, size_t size, size_t align, size_t block_slots)
+{
+    if (align < _Alignof(PoolSlot))
+        align = _Alignof(PoolSlot);
+    if (size < sizeof(PoolSlot))
+        size = sizeof(PoolSlot);
+    size = (size + align - 1) & ~(align - 1);
+    pool->free_list = NULL;
+    pool->slot_size = size;
+    pool->slot_align = align;
+    if (block_slots == 0 || block_slots > SIZE_MAX / size)
+        block_slots = 1;
+    return arena_init(&pool->arena, size * block_slots, 0);
+}
+
+static inline void *pool_alloc(Pool *pool, int flags)
+{
+    PoolSlot *slot = pool->free_list;
+    if (ARENA_LIKELY(slot != NULL))
+    {
+        pool->free_list = slot->next;
+        if (!(flags & ARENA_NO_ZERO))
+            memset(slot, 0, pool->slot_size);
+        return slot;
+    }
+    return arena_alloc(&pool->arena, pool->slot_size, pool->slot_align, 1, flags);
+}
+
+static inline void pool_free(Pool *pool, void *ptr)
+{
+    if (!ptr)
+        return;
+    PoolSlot *slot = (PoolSlot *)ptr;
+    slot->next = pool->free_list;
+    pool->free_list = slot;
+}
+
+static inline void pool_destroy(Pool *pool)
+{
+    arena_destroy(&pool->arena);
+    pool->free_list = NULL;
+}
+
+static inline void sizeclass_init(SizeClassAlloc *sc, Arena *arena)
+{
+    sc->arena = arena;
+    memset(sc->free_lists, 0, sizeof(sc->free_lists));
+}
+
+/* Maps 1..SIZECLASS_MAX bytes to a class index. */
+static inline size_t sizeclass_index(size_t size)
+{
+    if (size <= 8 * SIZECLASS_QUANTUM)
+        return (size + SIZECLASS_QUANTUM - 1) / SIZECLASS_QUANTUM - 1;
+    size_t x = size - 1;
+#if defined(__GNUC__) || defined(__clang__)
+    size_t lg = sizeof(unsigned long long) * 8 - 1 - (size_t)__builtin_clzll((unsigned long long)x);
+#else
+    size_t lg = 0;
+    while ((x >> lg) > 1)
+        lg++;
+#endif
+    return 8 + (lg - 7) * 4 + ((x >> (lg - 2)) & 3);
+}
+
+static inline size_t sizeclass_size(size_t index)
+{
+    if (index < 8)
+        return (index + 1) * SIZECLASS_QUANTUM;
+    size_t group = (index - 8) / 4;
+    size_t step = (index - 8) % 4;
+    return ((size_t)1 << (group + 7)) + (step + 1) * ((size_t)1 << (group + 5));
+}
+
+static inline void *sizeclass_alloc(SizeClassAlloc *sc, size_t size, int flags)
+{
+    if (size == 0)
+        return NULL;
+    if (size > SIZECLASS_MAX)
+        return arena_alloc(sc->arena, size, SIZECLASS_QUANTUM, 1, flags);
+    size_t index = sizeclass_index(size);
+    PoolSlot *slot = sc->free_lists[index];
+    if (slot)
+    {
+        sc->free_lists[index] = slot->next;
+        if (!(flags & ARENA_NO_ZERO))
+            memset(slot, 0, size);
+        return slot;
+    }
+    return arena_alloc(sc->arena, sizeclass_size(index), SIZECLASS_QUANTUM, 1, flags);
+}
+
+/* `size` must be the size the object was allocated with. */
+static inline void sizeclass_free(SizeClassAlloc *sc, void *ptr, size_t size)
+{
+    if (!ptr || size == 0 || size > SIZECLASS_MAX)
+        return;
+    size_t index = sizeclass_index(size);
+    PoolSlot *slot = (PoolSlot *)ptr;
+    slot->next = sc->free_lists[index];
+    sc->free_lists[index] = slot;
+}
+
+#endif /* P_MEMSUO_H */
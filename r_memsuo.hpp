@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef R_MEMSUO_HPP
+#define R_MEMSUO_HPP
+
+/**
+ * C++ allocator adapters.
+ *
+ * memsuo::ArenaResource is a std::pmr::memory_resource that carves every
+ * request from an Arena with arena_alloc, so pmr containers and strings get
+ * the arena's inline bump-pointer path. Like monotonic_buffer_resource it
+ * ignores deallocate; memory comes back when the arena is reset (release) or
+ * destroyed. It either wraps an existing Arena or owns one of its own.
+ *
+ * memsuo::MallocResource (shared instance from malloc_resource()) and the
+ * stateless memsuo::MallocAllocator<T> go through the MALLOCX family, so
+ * allocations are counted by the stats, profiler and latency hooks, and every
+ * deallocation passes its size to SDALLOCX, letting jemalloc skip the size
+ * class lookup. Over-aligned requests become MALLOCX_ALIGN flags.
+ *
+ * An ArenaResource must only be used by one thread at a time, like its
+ * arena; MallocResource and MallocAllocator are thread-safe. Requires C++17.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include "m_memsuo.h"
+#include "a_memsuo.h"
+
+namespace memsuo
+{
+
+namespace detail
+{
+
+/* Sizes of 0 are allocated as 1 byte, and freed the same way. */
+inline std::size_t malloc_size(std::size_t bytes) noexcept
+{
+    return bytes ? bytes : 1;
+}
+
+inline int malloc_flags(std::size_t align) noexcept
+{
+    return align > alignof(std::max_align_t) ? MALLOCX_ALIGN(align) : 0;
+}
+
+inline void *malloc_bytes(std::size_t bytes, std::size_t align)
+{
+    void *ptr = MALLOCX(malloc_size(bytes), malloc_flags(align));
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+inline void free_bytes(void *ptr, std::size_t bytes, std::size_t align) noexcept
+{
+    SDALLOCX(ptr, malloc_size(bytes), malloc_flags(align));
+}
+
+} // namespace detail
+
+class ArenaResource final : public std::pmr::memory_resource
+{
+public:
+    /* Allocates from `arena`, which must outlive the resource. */
+    explicit ArenaResource(Arena *arena) noexcept : arena_(arena), owned_(false)
+    {
+    }
+
+    /* Owns an arena created with arena_init(initial_size, secure_flag). */
+    explicit ArenaResource(std::size_t initial_size, int secure_flag = 0) : arena_(&own_), owned_(true)
+    {
+        if (arena_init(&own_, initial_size, secure_flag) != 0)
+            throw std::bad_alloc();
+    }
+
+    ArenaResource(const ArenaResource &) = delete;
+    ArenaResource &operator=(const ArenaResource &) = delete;
+
+    ~ArenaResource() override
+    {
+        if (owned_)
+            arena_destroy(&own_);
+    }
+
+    Arena *arena() const noexcept
+    {
+        return arena_;
+    }
+
+    /* Resets the arena; everything allocated through it becomes invalid. */
+    void release() noexcept
+    {
+        arena_reset(arena_);
+    }
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        void *ptr = arena_alloc(arena_, detail::malloc_size(bytes), align, 1, ARENA_NO_ZERO);
+        if (!ptr)
+            throw std::bad_alloc();
+        return ptr;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override
+    {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    Arena *arena_;
+    Arena own_;
+    bool owned_;
+};
+
+class MallocResource final : public std::pmr::memory_resource
+{
+private:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        return detail::malloc_bytes(bytes, align);
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t align) override
+    {
+        detail::free_bytes(ptr, bytes, align);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return dynamic_cast<const MallocResource *>(&other) != nullptr;
+    }
+};
+
+/* Process-wide MallocResource, the counterpart of new_delete_resource(). */
+inline std::pmr::memory_resource *malloc_resource() noexcept
+{
+    static MallocResource resource;
+    return &resource;
+}
+
+template <typename T> class MallocAllocator
+{
+public:
+    using value_type = T;
+
+    MallocAllocator() noexcept = default;
+
+    template <typename U> MallocAllocator(const MallocAllocator<U> &) noexcept
+    {
+    }
+
+    T *allocate(std::size_t n)
+    {
+        if (n > SIZE_MAX / sizeof(T))
+            throw std::bad_array_new_length();
+        return static_cast<T *>(detail::malloc_bytes(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept
+    {
+        detail::free_bytes(ptr, n * sizeof(T), alignof(T));
+    }
+};
+
+template <typename T, typename U> bool operator==(const MallocAllocator<T> &, const MallocAllocator<U> &) noexcept
+{
+    return true;
+}
+
+template <typename T, typename U> bool operator!=(const MallocAllocator<T> &, const MallocAllocator<U> &) noexcept
+{
+    return false;
+}
+
+} // namespace memsuo
+
+#endif /* R_MEMSUO_HPP */
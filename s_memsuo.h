@@ -0,0 +1,467 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef S_MEMSUO_H
+#define S_MEMSUO_H
+
+/**
+ * Secure slab allocator.
+ *
+ * sodium_malloc spends a guard page pair, an mlock and several syscalls on
+ * every allocation and rounds each one up to whole pages. A SecureSlab
+ * instead maps SECURE_SLAB_REGION-sized regions that are locked, excluded
+ * from core dumps and fenced by PROT_NONE guard pages, and carves them into
+ * slots of SECURE_SLAB_CLASSES power-of-two sizes, so thousands of 32-byte
+ * keys and a secure arena's first blocks share one region. A region that
+ * cannot be guarded or locked is unmapped and the allocation fails. Requests
+ * above SECURE_SLAB_MAX_SLOT get a dedicated guarded region of their own.
+ *
+ * Every slot is followed by a canary derived from a per-slab random key and
+ * the slot address. It is only checked by secure_slab_free, so it catches a
+ * write past the end of a slot once the slot is released, not when the write
+ * happens, and it does not see underruns. Free also rejects double frees and
+ * wipes the slot before reuse.
+ *
+ * Each region begins with its chunk header, so a pointer is freed through
+ * the slab that allocated it whichever translation unit frees it. Memory is
+ * always returned zeroed. SECURE_ALLOC/SECURE_FREE use a process-wide default
+ * slab, defined weakly below; secure arenas allocate their blocks from it too.
+ */
+
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "s_memsuo.h needs mmap, mprotect and mlock"
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef USE_SODIUM
+#include <sodium.h>
+#elif !defined(__APPLE__)
+#include <sys/random.h>
+#endif
+
+#ifndef SECURE_SLAB_REGION
+#define SECURE_SLAB_REGION (64 * 1024)
+#endif
+#define SECURE_SLAB_MIN_SLOT 16
+#define SECURE_SLAB_MAX_SLOT (16 * 1024)
+#define SECURE_SLAB_CLASSES 11
+#if SECURE_SLAB_REGION < 4 * SECURE_SLAB_MAX_SLOT
+#error "SECURE_SLAB_REGION must hold at least four of the largest slots"
+#endif
+#define SECURE_SLAB_CANARY 16 /* trailer per slot; keeps 16-byte alignment */
+#define SECURE_SLAB_LARGE SECURE_SLAB_CLASSES
+#define SECURE_SLAB_BITMAP_WORDS (SECURE_SLAB_REGION / (SECURE_SLAB_MIN_SLOT + SECURE_SLAB_CANARY) / 64 + 1)
+
+struct SecureSlab;
+
+typedef struct SecureSlabChunk
+{
+    uint64_t magic; /* slab key ^ chunk address */
+    struct SecureSlab *slab;
+    struct SecureSlabChunk *prev;
+    struct SecureSlabChunk *next;
+    unsigned char *data;
+    size_t map_size; /* bytes between the guard pages */
+    size_t stride;
+    size_t size_class;
+    uint32_t slots;
+    uint32_t used;
+    uint32_t hint;
+    uint64_t bitmap[SECURE_SLAB_BITMAP_WORDS]; /* 1 = slot in use */
+} SecureSlabChunk;
+
+typedef struct SecureSlab
+{
+    int lock;
+    int ready;
+    uint64_t key;
+    SecureSlabChunk *classes[SECURE_SLAB_CLASSES];
+    SecureSlabChunk *large; /* dedicated regions, one allocation each */
+    size_t mapped_bytes;
+} SecureSlab;
+
+__attribute__((weak)) SecureSlab __secure_slab_default;
+
+#define SECURE_ALLOC(Type, count) ((Type *)secure_slab_alloc_array(&__secure_slab_default, sizeof(Type), (count)))
+#define SECURE_FREE(ptr) (secure_slab_free((ptr)))
+
+#define SECURE_SLAB_CHUNK_BYTES ((sizeof(SecureSlabChunk) + 63) & ~(size_t)63)
+
+/* A wipe the compiler cannot drop: sodium_memzero, or memset through a volatile pointer. */
+static inline void secure_memzero(void *ptr, size_t len)
+{
+#ifdef USE_SODIUM
+    sodium_memzero(ptr, len);
+#else
+    static void *(*const volatile wipe)(void *, int, size_t) = memset;
+    wipe(ptr, 0, len);
+#endif
+}
+
+static inline void __secure_slab_misuse(const char *what)
+{
+    fprintf(stderr, "secure slab: %s\n", what);
+    abort();
+}
+
+static inline void __secure_slab_lock(SecureSlab *slab)
+{
+    while (__atomic_exchange_n(&slab->lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&slab->lock, __ATOMIC_RELAXED))
+            sched_yield();
+    }
+}
+
+static inline void __secure_slab_unlock(SecureSlab *slab)
+{
+    __atomic_store_n(&slab->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* A guessable key would let an attacker forge canaries, so there is no fallback source. */
+static inline uint64_t __secure_slab_random(void)
+{
+    uint64_t key = 0;
+#ifdef USE_SODIUM
+    if (sodium_init() < 0)
+        __secure_slab_misuse("libsodium failed to initialise, no canary key");
+    randombytes_buf(&key, sizeof(key));
+#elif defined(__APPLE__)
+    arc4random_buf(&key, sizeof(key));
+#else
+    ssize_t got;
+    do
+        got = getrandom(&key, sizeof(key), 0);
+    while (got < 0 && errno == EINTR);
+    if (got != (ssize_t)sizeof(key))
+        __secure_slab_misuse("getrandom unavailable, no canary key");
+#endif
+    return key;
+}
+
+static inline uint64_t __secure_slab_canary(const SecureSlab *slab, const void *slot)
+{
+    uint64_t x = slab->key ^ (uint64_t)(uintptr_t)slot;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline size_t __secure_slab_class(size_t size)
+{
+    size_t cls = 0, cap = SECURE_SLAB_MIN_SLOT;
+    while (cap < size)
+    {
+        cap <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+/*
+ * Maps `size` bytes aligned to SECURE_SLAB_REGION with a PROT_NONE page on
+ * each side, then locks them and keeps them out of core dumps. Returns NULL
+ * if the guards cannot be set or RLIMIT_MEMLOCK refuses the lock; excluding
+ * the region from core dumps stays best effort.
+ */
+static inline unsigned char *__secure_region_map(size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t span = size + SECURE_SLAB_REGION + 2 * page;
+    unsigned char *raw = (unsigned char *)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+    uintptr_t start = ((uintptr_t)raw + page + SECURE_SLAB_REGION - 1) & ~(uintptr_t)(SECURE_SLAB_REGION - 1);
+    unsigned char *lo = (unsigned char *)start - page;
+    unsigned char *hi = (unsigned char *)start + size + page;
+    if (lo > raw)
+        munmap(raw, (size_t)(lo - raw));
+    if (raw + span > hi)
+        munmap(hi, (size_t)(raw + span - hi));
+    if (mprotect(lo, page, PROT_NONE) != 0 || mprotect(hi - page, page, PROT_NONE) != 0 ||
+        mlock((void *)start, size) != 0)
+    {
+        munmap(lo, size + 2 * page);
+        return NULL;
+    }
+#ifdef MADV_DONTDUMP
+    madvise((void *)start, size, MADV_DONTDUMP);
+#endif
+    return (unsigned char *)start;
+}
+
+static inline void __secure_region_unmap(unsigned char *start, size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    secure_memzero(start, size);
+    munlock(start, size);
+    munmap(start - page, size + 2 * page);
+}
+
+static inline SecureSlabChunk *__secure_chunk_new(SecureSlab *slab, size_t cls, size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t stride = size + SECURE_SLAB_CANARY;
+    size_t map_size = SECURE_SLAB_REGION;
+    if (cls == SECURE_SLAB_LARGE)
+    {
+        if (stride < size || SECURE_SLAB_CHUNK_BYTES + stride < stride)
+            return NULL;
+        map_size = (SECURE_SLAB_CHUNK_BYTES + stride + page - 1) & ~(page - 1);
+    }
+    unsigned char *region = __secure_region_map(map_size);
+    if (!region)
+        return NULL;
+    SecureSlabChunk *chunk = (SecureSlabChunk *)region;
+    chunk->magic = slab->key ^ (uint64_t)(uintptr_t)chunk;
+    chunk->slab = slab;
+    chunk->prev = NULL;
+    chunk->next = NULL;
+    chunk->data = region + SECURE_SLAB_CHUNK_BYTES;
+    chunk->map_size = map_size;
+    chunk->stride = stride;
+    chunk->size_class = cls;
+    chunk->slots = cls == SECURE_SLAB_LARGE ? 1 : (uint32_t)((map_size - SECURE_SLAB_CHUNK_BYTES) / stride);
+    chunk->used = 0;
+    chunk->hint = 0;
+    slab->mapped_bytes += map_size;
+    return chunk;
+}
+
+static inline SecureSlabChunk **__secure_chunk_head(SecureSlab *slab, size_t cls)
+{
+    return cls == SECURE_SLAB_LARGE ? &slab->large : &slab->classes[cls];
+}
+
+static inline void __secure_chunk_unlink(SecureSlab *slab, SecureSlabChunk *chunk)
+{
+    if (chunk->prev)
+        chunk->prev->next = chunk->next;
+    else
+        *__secure_chunk_head(slab, chunk->size_class) = chunk->next;
+    if (chunk->next)
+        chunk->next->prev = chunk->prev;
+    chunk->prev = chunk->next = NULL;
+}
+
+static inline void __secure_chunk_push(SecureSlab *slab, SecureSlabChunk *chunk)
+{
+    SecureSlabChunk **head = __secure_chunk_head(slab, chunk->size_class);
+    chunk->prev = NULL;
+    chunk->next = *head;
+    if (*head)
+        (*head)->prev = chunk;
+    *head = chunk;
+}
+
+static inline uint32_t __secure_chunk_take(SecureSlabChunk *chunk)
+{
+    uint32_t words = (chunk->slots + 63) / 64;
+    for (uint32_t n = 0; n < words; n++)
+    {
+        uint32_t w = (chunk->hint + n) % words;
+        uint64_t bits = chunk->bitmap[w];
+        if (w == words - 1 && chunk->slots % 64)
+            bits |= ~(((uint64_t)1 << (chunk->slots % 64)) - 1);
+        if (bits != UINT64_MAX)
+        {
+            uint32_t bit = (uint32_t)__builtin_ctzll(~bits);
+            chunk->bitmap[w] |= (uint64_t)1 << bit;
+            chunk->hint = w;
+            chunk->used++;
+            return w * 64 + bit;
+        }
+    }
+    return UINT32_MAX;
+}
+
+static inline int secure_slab_init(SecureSlab *slab)
+{
+    memset(slab, 0, sizeof(*slab));
+    slab->key = __secure_slab_random();
+    __atomic_store_n(&slab->ready, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Returns `size` zeroed bytes, 16-byte aligned, or NULL. */
+static inline void *secure_slab_alloc(SecureSlab *slab, size_t size)
+{
+    if (size == 0)
+        return NULL;
+    if (!__atomic_load_n(&slab->ready, __ATOMIC_ACQUIRE))
+    {
+        __secure_slab_lock(slab);
+        if (!slab->ready)
+        {
+            slab->key = __secure_slab_random();
+            __atomic_store_n(&slab->ready, 1, __ATOMIC_RELEASE);
+        }
+        __secure_slab_unlock(slab);
+    }
+    __secure_slab_lock(slab);
+    SecureSlabChunk *chunk;
+    uint32_t slot;
+    if (size > SECURE_SLAB_MAX_SLOT)
+    {
+        chunk = __secure_chunk_new(slab, SECURE_SLAB_LARGE, size);
+        if (!chunk)
+        {
+            __secure_slab_unlock(slab);
+            return NULL;
+        }
+        chunk->bitmap[0] = 1;
+        chunk->used = 1;
+        slot = 0;
+        __secure_chunk_push(slab, chunk);
+    }
+    else
+    {
+        size_t cls = __secure_slab_class(size);
+        chunk = slab->classes[cls];
+        while (chunk && chunk->used == chunk->slots)
+            chunk = chunk->next;
+        if (!chunk)
+        {
+            chunk = __secure_chunk_new(slab, cls, (size_t)SECURE_SLAB_MIN_SLOT << cls);
+            if (!chunk)
+            {
+                __secure_slab_unlock(slab);
+                return NULL;
+            }
+            __secure_chunk_push(slab, chunk);
+        }
+        else if (chunk != slab->classes[cls])
+        {
+            __secure_chunk_unlink(slab, chunk);
+            __secure_chunk_push(slab, chunk);
+        }
+        slot = __secure_chunk_take(chunk);
+    }
+    unsigned char *ptr = chunk->data + (size_t)slot * chunk->stride;
+    uint64_t canary = __secure_slab_canary(slab, ptr);
+    memcpy(ptr + chunk->stride - SECURE_SLAB_CANARY, &canary, sizeof(canary));
+    __secure_slab_unlock(slab);
+    return ptr;
+}
+
+static inline void *secure_slab_alloc_array(SecureSlab *slab, size_t size, size_t count)
+{
+    if (count != 0 && size > SIZE_MAX / count)
+        return NULL;
+    return secure_slab_alloc(slab, size * count);
+}
+
+/* The bytes a request for `size` really receives: its slot, or its page-rounded dedicated region. */
+static inline size_t secure_slab_usable(size_t size)
+{
+    if (size == 0 || size <= SECURE_SLAB_MAX_SLOT)
+        return size ? (size_t)SECURE_SLAB_MIN_SLOT << __secure_slab_class(size) : 0;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t need = SECURE_SLAB_CHUNK_BYTES + size + SECURE_SLAB_CANARY;
+    if (need < size || need > SIZE_MAX - page)
+        return size;
+    return ((need + page - 1) & ~(page - 1)) - SECURE_SLAB_CHUNK_BYTES - SECURE_SLAB_CANARY;
+}
+
+/*
+ * Verifies the canary, wipes the slot and releases it. Aborts on a pointer
+ * the slab did not hand out, a double free or an overwritten canary.
+ */
+static inline void secure_slab_free(void *ptr)
+{
+    if (!ptr)
+        return;
+    SecureSlabChunk *chunk = (SecureSlabChunk *)((uintptr_t)ptr & ~(uintptr_t)(SECURE_SLAB_REGION - 1));
+    SecureSlab *slab = chunk->slab;
+    if (!slab || chunk->magic != (slab->key ^ (uint64_t)(uintptr_t)chunk))
+        __secure_slab_misuse("free of a pointer it does not own");
+    size_t offset = (size_t)((unsigned char *)ptr - chunk->data);
+    if ((unsigned char *)ptr < chunk->data || offset % chunk->stride != 0 || offset / chunk->stride >= chunk->slots)
+        __secure_slab_misuse("free of a misaligned pointer");
+    uint32_t slot = (uint32_t)(offset / chunk->stride);
+
+    __secure_slab_lock(slab);
+    uint64_t bit = (uint64_t)1 << (slot % 64);
+    if (!(chunk->bitmap[slot / 64] & bit))
+        __secure_slab_misuse("double free");
+    uint64_t canary;
+    memcpy(&canary, (unsigned char *)ptr + chunk->stride - SECURE_SLAB_CANARY, sizeof(canary));
+    if (canary != __secure_slab_canary(slab, ptr))
+        __secure_slab_misuse("canary overwritten");
+    secure_memzero(ptr, chunk->stride);
+    chunk->bitmap[slot / 64] &= ~bit;
+    chunk->used--;
+    if (slot / 64 < chunk->hint)
+        chunk->hint = slot / 64;
+    if (chunk->size_class == SECURE_SLAB_LARGE)
+    {
+        __secure_chunk_unlink(slab, chunk);
+        slab->mapped_bytes -= chunk->map_size;
+        __secure_region_unmap((unsigned char *)chunk, chunk->map_size);
+    }
+    else if (chunk->used == 0 && (chunk->prev || chunk->next))
+    {
+        /* Keep one empty region per class to absorb churn; unmap the rest. */
+        __secure_chunk_unlink(slab, chunk);
+        slab->mapped_bytes -= chunk->map_size;
+        __secure_region_unmap((unsigned char *)chunk, chunk->map_size);
+    }
+    else if (chunk->prev)
+    {
+        /* Move regions with free slots to the front so allocation finds them first. */
+        __secure_chunk_unlink(slab, chunk);
+        __secure_chunk_push(slab, chunk);
+    }
+    __secure_slab_unlock(slab);
+}
+
+/* Wipes and unmaps every region. Outstanding pointers become invalid. */
+static inline void secure_slab_destroy(SecureSlab *slab)
+{
+    __secure_slab_lock(slab);
+    for (size_t cls = 0; cls <= SECURE_SLAB_LARGE; cls++)
+    {
+        SecureSlabChunk **head = __secure_chunk_head(slab, cls);
+        SecureSlabChunk *chunk = *head;
+        while (chunk)
+        {
+            SecureSlabChunk *next = chunk->next;
+            __secure_region_unmap((unsigned char *)chunk, chunk->map_size);
+            chunk = next;
+        }
+        *head = NULL;
+    }
+    slab->mapped_bytes = 0;
+    __secure_slab_unlock(slab);
+}
+
+#endif /* S_MEMSUO_H */
@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2025, 7etsuo  https://tetsuo.ai/
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef T_MEMSUO_H
+#define T_MEMSUO_H
+
+/**
+ * Per-thread scratch arenas.
+ *
+ * Every thread owns one cached Arena. ARENA_SCOPE_TLS borrows it for the
+ * enclosing scope and rewinds it on exit, so once a worker has warmed up its
+ * blocks a task allocates without calling malloc. At most
+ * ARENA_TLS_MAX_RETAIN bytes of blocks stay with a thread between tasks;
+ * anything above that, and everything a thread owns when it exits, goes to a
+ * global pool that new threads draw from before allocating fresh blocks.
+ *
+ * The shared state is defined weakly below, so programs need no definition of
+ * their own. The thread-local uses GNU __thread, which C and C++ both accept.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "a_memsuo.h"
+
+#ifndef ARENA_TLS_BLOCK_SIZE
+#define ARENA_TLS_BLOCK_SIZE (64 * 1024)
+#endif
+#ifndef ARENA_TLS_MAX_RETAIN
+#define ARENA_TLS_MAX_RETAIN (4 * 1024 * 1024)
+#endif
+#ifndef ARENA_TLS_POOL_MAX_BYTES
+#define ARENA_TLS_POOL_MAX_BYTES (64 * 1024 * 1024)
+#endif
+
+typedef struct ArenaTlsPool
+{
+    int lock;
+    int key_ready;
+    pthread_key_t key;
+    ArenaBlock *blocks;
+    size_t cached_bytes;
+} ArenaTlsPool;
+
+typedef struct ArenaTls
+{
+    Arena arena;
+    int depth;
+    int registered;
+} ArenaTls;
+
+__attribute__((weak)) ArenaTlsPool g_arena_tls_pool;
+__attribute__((weak)) __thread ArenaTls g_arena_tls;
+
+static inline ArenaScratch arena_tls_begin(void);
+static inline void arena_tls_end(ArenaScratch *scratch);
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ARENA_SCOPE_TLS(name)                                                                                          \
+    __attribute__((cleanup(arena_tls_end))) ArenaScratch name##_tls_scratch = arena_tls_begin();                       \
+    Arena *name = name##_tls_scratch.arena
+#else
+#define ARENA_SCOPE_TLS(name)                                                                                          \
+    ArenaScratch name##_tls_scratch = arena_tls_begin();                                                               \
+    Arena *name = name##_tls_scratch.arena
+#endif
+
+static inline void arena_tls_pool_lock(ArenaTlsPool *pool)
+{
+    while (__atomic_exchange_n(&pool->lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(&pool->lock, __ATOMIC_RELAXED))
+            sched_yield();
+    }
+}
+
+static inline void arena_tls_pool_unlock(ArenaTlsPool *pool)
+{
+    __atomic_store_n(&pool->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Hands a chain of blocks to the global pool, freeing what exceeds its cap. */
+static inline void arena_tls_pool_put(Arena *owner, ArenaBlock *chain)
+{
+    ArenaTlsPool *pool = &g_arena_tls_pool;
+    arena_tls_pool_lock(pool);
+    while (chain)
+    {
+        ArenaBlock *next = chain->next;
+        if (pool->cached_bytes + chain->capacity <= ARENA_TLS_POOL_MAX_BYTES)
+        {
+            chain->used = 0;
+            chain->next = pool->blocks;
+            pool->blocks = chain;
+            pool->cached_bytes += chain->capacity;
+        }
+        else
+        {
+            arena_block_free(owner, chain);
+        }
+        chain = next;
+    }
+    arena_tls_pool_unlock(pool);
+}
+
+/* Takes up to ARENA_TLS_MAX_RETAIN bytes of pooled blocks for a new thread. */
+static inline ArenaBlock *arena_tls_pool_take(void)
+{
+    ArenaTlsPool *pool = &g_arena_tls_pool;
+    ArenaBlock *head = NULL, **tail = &head;
+    size_t taken = 0;
+    arena_tls_pool_lock(pool);
+    ArenaBlock **link = &pool->blocks;
+    while (*link)
+    {
+        ArenaBlock *block = *link;
+        if (taken + block->capacity > ARENA_TLS_MAX_RETAIN)
+        {
+            link = &block->next;
+            continue;
+        }
+        *link = block->next;
+        pool->cached_bytes -= block->capacity;
+        taken += block->capacity;
+        block->next = NULL;
+        *tail = block;
+        tail = &block->next;
+    }
+    arena_tls_pool_unlock(pool);
+    return head;
+}
+
+/* Keeps the leading blocks that fit ARENA_TLS_MAX_RETAIN and pools the rest. */
+static inline void arena_tls_trim(ArenaTls *tls)
+{
+    ArenaBlock *block = tls->arena.blocks;
+    size_t kept = 0;
+    while (block && block->next)
+    {
+        kept += block->capacity;
+        if (kept + block->next->capacity > ARENA_TLS_MAX_RETAIN)
+        {
+            ArenaBlock *rest = block->next;
+            block->next = NULL;
+            arena_tls_pool_put(&tls->arena, rest);
+            arena_recount(&tls->arena);
+            return;
+        }
+        block = block->next;
+    }
+}
+
+/*
+ * Returns everything the calling thread holds to the global pool. Runs
+ * automatically when a thread that used ARENA_SCOPE_TLS exits; the main
+ * thread can call it directly before returning.
+ */
+static inline void arena_tls_release(void)
+{
+    ArenaTls *tls = &g_arena_tls;
+    arena_release_large(&tls->arena, NULL);
+    arena_store_current(&tls->arena);
+    ArenaBlock *chain = tls->arena.blocks;
+    tls->arena.blocks = NULL;
+    tls->arena.current = NULL;
+    tls->arena.ptr = NULL;
+    tls->arena.end = NULL;
+    tls->arena.clean = NULL;
+    arena_recount(&tls->arena);
+    tls->depth = 0;
+    if (chain)
+        arena_tls_pool_put(&tls->arena, chain);
+}
+
+static inline void arena_tls_thread_exit(void *arg)
+{
+    (void)arg;
+    arena_tls_release();
+}
+
+/* Frees every block parked in the global pool. */
+static inline void arena_tls_pool_trim(void)
+{
+    ArenaTlsPool *pool = &g_arena_tls_pool;
+    Arena owner;
+    arena_init(&owner, 0, 0);
+    arena_tls_pool_lock(pool);
+    owner.blocks = pool->blocks;
+    pool->blocks = NULL;
+    pool->cached_bytes = 0;
+    arena_tls_pool_unlock(pool);
+    arena_destroy(&owner);
+}
+
+static inline void arena_tls_register(ArenaTls *tls)
+{
+    ArenaTlsPool *pool = &g_arena_tls_pool;
+    if (!__atomic_load_n(&pool->key_ready, __ATOMIC_ACQUIRE))
+    {
+        arena_tls_pool_lock(pool);
+        if (!pool->key_ready && pthread_key_create(&pool->key, arena_tls_thread_exit) == 0)
+            __atomic_store_n(&pool->key_ready, 1, __ATOMIC_RELEASE);
+        arena_tls_pool_unlock(pool);
+    }
+    if (__atomic_load_n(&pool->key_ready, __ATOMIC_ACQUIRE))
+        pthread_setspecific(pool->key, tls);
+    tls->registered = 1;
+}
+
+static inline ArenaScratch arena_tls_begin(void)
+{
+    ArenaTls *tls = &g_arena_tls;
+    if (ARENA_UNLIKELY(!tls->registered))
+        arena_tls_register(tls);
+    if (ARENA_UNLIKELY(!tls->arena.blocks))
+    {
+        arena_init(&tls->arena, 0, 0);
+        tls->arena.blocks = arena_tls_pool_take();
+        if (!tls->arena.blocks)
+            arena_init(&tls->arena, ARENA_TLS_BLOCK_SIZE, 0);
+        arena_recount(&tls->arena);
+    }
+    tls->depth++;
+    return arena_scratch_begin(&tls->arena);
+}
+
+static inline void arena_tls_end(ArenaScratch *scratch)
+{
+    ArenaTls *tls = &g_arena_tls;
+    if (--tls->depth > 0)
+    {
+        arena_rewind(scratch->arena, scratch->mark);
+        return;
+    }
+    arena_reset(&tls->arena);
+    arena_tls_trim(tls);
+}
+
+#endif /* T_MEMSUO_H */
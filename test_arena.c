@@ -1,3 +1,4 @@
+#define ARENA_TRACK_PADDING
 #include <stdio.h>
 #include <string.h>
 #include "a_memsuo.h"
@@ -32,16 +33,204 @@ int main(void)
     strcpy(message, "Hello from the normal arena!");
     printf("Message: %s\n", message);
 
-#if defined(USE_SODIUM) || defined(USE_LIBSODIUM)
-    /* Create a secure arena that uses libsodium’s guarded memory functions.
-       Memory allocated from this arena will be zeroed on free and kept locked. */
+    /* Take a mark, allocate scratch memory past it, and rewind: the next
+       allocation reuses the same bytes instead of bumping further. */
+    ArenaMark mark = arena_mark(&arena);
+    char *scratch = ARENA_ALLOC(&arena, char, 4096);
+    strcpy(scratch, "Scratch data that forces a second block");
+    arena_rewind(&arena, mark);
+    char *reused = ARENA_ALLOC_NOZERO(&arena, char, 16);
+    printf("Rewind reuses position: %s\n", reused == (char *)mark.ptr ? "yes" : "no");
+
+    /* Bytes dirtied before a rewind must be cleared again by ARENA_ALLOC. */
+    memset(reused, 0x7f, 16);
+    arena_rewind(&arena, mark);
+    char *rezeroed = ARENA_ALLOC(&arena, char, 16);
+    printf("Rewound bytes rezeroed: %s\n", rezeroed[0] == 0 && rezeroed[15] == 0 ? "yes" : "no");
+
+    /* Nested scratch scope: everything allocated inside is released at the
+       closing brace. */
+    {
+        ARENA_SCRATCH_SCOPE(tmp, &arena);
+        int *tmp_numbers = ARENA_ALLOC(&arena, int, 2048);
+        tmp_numbers[0] = 42;
+        printf("Scratch scope value: %d\n", tmp_numbers[0]);
+    }
+
+    /* Reset keeps every block that has been grown so far, so refilling the
+       arena to the same size needs no new blocks. */
+    ArenaBlock *first_block = arena.blocks;
+    arena_reset(&arena);
+    char *after_reset = ARENA_ALLOC(&arena, char, 4096);
+    printf("Reset retains blocks: %s\n",
+           (arena.blocks == first_block && arena.current == first_block->next && after_reset) ? "yes" : "no");
+
+    /* Growing the most recent allocation extends it in place. */
+    int *grow = ARENA_ALLOC(&arena, int, 4);
+    int *grown = ARENA_REALLOC(&arena, grow, int, 4, 64);
+    printf("Realloc at bump pointer stays in place: %s\n", grown == grow ? "yes" : "no");
+    printf("Overflowing realloc refused: %s\n", ARENA_REALLOC(&arena, grown, int, 64, SIZE_MAX / 2) == NULL ? "yes" : "no");
+
+    /* Arena-backed dynamic array and string builder with amortized growth. */
+    ArenaArray squares;
+    ARENA_ARRAY_INIT(&squares, &arena, long);
+    for (long i = 0; i < 1000; i++)
+        ARENA_ARRAY_PUSH(&squares, long, i * i);
+    printf("ArenaArray: len %zu, [999] = %ld\n", squares.len, ARENA_ARRAY_AT(&squares, long, 999));
+
+    ArenaStr out;
+    arena_str_init(&out, &arena);
+    for (int i = 0; i < 3; i++)
+        arena_str_appendf(&out, "{\"id\":%d}%s", i, i < 2 ? "," : "");
+    arena_str_append(&out, "!", 1);
+    printf("ArenaStr: %s (len %zu)\n", arena_str_cstr(&out), out.len);
+
+    /* A vm arena reserves address space up front and commits pages as the
+       bump pointer reaches them, so even large allocation sequences stay in
+       one contiguous region. */
+    ARENA_SCOPE_VM(vm_arena, (size_t)1 << 30);
+    char *first = ARENA_ALLOC_NOZERO(&vm_arena, char, 1);
+    char *big = ARENA_ALLOC(&vm_arena, char, 8 * 1024 * 1024);
+    char *tail = ARENA_ALLOC_NOZERO(&vm_arena, char, 1);
+    if (!first || !big || !tail)
+    {
+        fprintf(stderr, "VM arena allocation failed\n");
+        return 1;
+    }
+    big[8 * 1024 * 1024 - 1] = 'x';
+    printf("VM arena contiguous: %s, blocks: %s\n", (big == first + 1 && tail == big + 8 * 1024 * 1024) ? "yes" : "no",
+           vm_arena.blocks->next == NULL ? "1" : "more");
+    arena_reset(&vm_arena);
+    char *again = ARENA_ALLOC(&vm_arena, char, 16);
+    printf("VM arena reset reuses base: %s\n", again == first ? "yes" : "no");
+
+    /* Create a secure arena whose blocks come from the secure slab's locked,
+       guarded regions. Memory allocated from this arena is zeroed on free. */
     ARENA_SCOPE_SECURE(sec_arena, 1024);
     char *secret = ARENA_ALLOC(&sec_arena, char, 50);
     strcpy(secret, "Sensitive Data");
     printf("Secure Arena Allocation: %s\n", secret);
+
+    /* Resetting a secure arena scrubs the bytes that were handed out. */
+    arena_reset(&sec_arena);
+    printf("Secure reset scrubbed: %s\n", secret[0] == 0 ? "yes" : "no");
+    secret = ARENA_ALLOC(&sec_arena, char, 50);
+    strcpy(secret, "Sensitive Data");
+
+    /* Block headers live inside the block, and a destroyed arena's blocks go
+       to the shared cache for the next short-lived arena to pick up. */
+    {
+        Arena shortlived;
+        arena_init(&shortlived, 8192, 0);
+        ArenaBlock *block = shortlived.blocks;
+        printf("Block header embedded: %s\n", block->base == (unsigned char *)block + ARENA_BLOCK_HEADER ? "yes" : "no");
+        memset(ARENA_ALLOC_NOZERO(&shortlived, char, 8192), 0x55, 8192);
+        arena_destroy(&shortlived);
+#ifdef ENABLE_ARENA_BLOCK_CACHE
+        arena_init(&shortlived, 8192, 0);
+        char *recycled = ARENA_ALLOC(&shortlived, char, 8192);
+        printf("Block cache reused block: %s, rezeroed: %s\n", shortlived.blocks == block ? "yes" : "no",
+               recycled[0] == 0 && recycled[8191] == 0 ? "yes" : "no");
+        arena_destroy(&shortlived);
+
+        /* A calloc'd block starts untouched; dirtying it as the current block
+           must still be remembered when it goes back to the cache. */
+        arena_init(&shortlived, ARENA_CALLOC_MIN, 0);
+        ArenaBlock *big = shortlived.blocks;
+        memset(ARENA_ALLOC_NOZERO(&shortlived, char, 4096), 0xab, 4096);
+        arena_destroy(&shortlived);
+        arena_init(&shortlived, ARENA_CALLOC_MIN, 0);
+        char *reissued = ARENA_ALLOC(&shortlived, char, 4096);
+        size_t dirty = 0;
+        for (int i = 0; i < 4096; i++)
+            dirty += reissued[i] != 0;
+        printf("Cached current block rezeroed: %s\n", shortlived.blocks == big && dirty == 0 ? "yes" : "no");
+        arena_destroy(&shortlived);
+
+        /* A request under a quarter of a cached block's size leaves it cached. */
+        arena_init(&shortlived, 16000, 0);
+        arena_destroy(&shortlived);
+        ArenaBlock *oversized = arena_block_cache_take(2049);
+        printf("Block cache refuses blocks four times too big: %s\n", oversized == NULL ? "yes" : "no");
+        if (oversized)
+            arena_block_cache_put(oversized);
+        arena_block_cache_trim(0);
+        printf("Block cache empty after trim: %s\n", g_arena_block_cache.bytes == 0 ? "yes" : "no");
+#endif
+    }
+
+    /* Requests at or above the large threshold get their own side block, so
+       the bump block keeps its position, and a rewind hands them back. */
+    {
+        Arena grown;
+        arena_init(&grown, 4096, 0);
+        arena_set_growth(&grown, 150, 64 * 1024, 16 * 1024);
+        char *small = ARENA_ALLOC(&grown, char, 64);
+        ArenaMark gm = arena_mark(&grown);
+        char *huge = ARENA_ALLOC(&grown, char, 256 * 1024);
+        char *after = ARENA_ALLOC(&grown, char, 64);
+        printf("Large request on side block: %s, bump block kept: %s\n",
+               grown.large && huge >= (char *)grown.large->base ? "yes" : "no", after == small + 64 ? "yes" : "no");
+        arena_rewind(&grown, gm);
+        printf("Rewind released side blocks: %s\n", grown.large == NULL ? "yes" : "no");
+        for (int i = 0; i < 64; i++)
+            ARENA_ALLOC_NOZERO(&grown, char, 4000);
+        size_t largest = 0;
+        for (ArenaBlock *b = grown.blocks; b; b = b->next)
+            largest = b->capacity > largest ? b->capacity : largest;
+        printf("Growth capped at max block: %s\n", largest <= 64 * 1024 ? "yes" : "no");
+        arena_destroy(&grown);
+    }
+
+    /* Stats: one byte then an aligned int costs three bytes of padding, and
+       a request that overflows the first block abandons its tail. */
+    {
+        ARENA_SCOPE(measured, 1024);
+        ARENA_ALLOC(&measured, char, 1);
+        ARENA_ALLOC(&measured, int, 1);
+        ArenaMark sm = arena_mark(&measured);
+        ARENA_ALLOC(&measured, char, 2000);
+        ArenaStats st;
+        arena_stats(&measured, &st);
+        printf("Arena stats: blocks %zu, used %zu, padding %zu, tail %zu\n", st.blocks, st.used, st.padding,
+               st.tail_waste);
+        printf("Stats consistent: %s\n",
+               st.blocks == 2 && st.used == 2008 && st.padding == 3 && st.tail_waste == 1024 - 8 ? "yes" : "no");
+        arena_rewind(&measured, sm);
+        arena_stats(&measured, &st);
+        printf("High-water survives rewind: %s\n", st.used == 8 && st.high_water == 2008 ? "yes" : "no");
+    }
+
+    /* Adaptive trimming: a one-off spike is kept for a few resets, then the
+       arena falls back to what its steady cycles use. */
+    {
+        Arena worker;
+        arena_init(&worker, 4096, 0);
+        arena_set_trim(&worker, 50);
+        ARENA_ALLOC_NOZERO(&worker, char, 4 * 1024 * 1024);
+        arena_reset(&worker);
+        ArenaStats st;
+        arena_stats(&worker, &st);
+        size_t after_spike = st.capacity;
+        for (int cycle = 0; cycle < 20; cycle++)
+        {
+            ARENA_ALLOC(&worker, char, 3000);
+            arena_reset(&worker);
+        }
+        arena_stats(&worker, &st);
+        printf("Trim kept spike, then released it: %s (%zu -> %zu bytes)\n",
+               after_spike >= 4 * 1024 * 1024 && st.capacity < 64 * 1024 ? "yes" : "no", after_spike, st.capacity);
+        arena_destroy(&worker);
+    }
+#ifdef ENABLE_ARENA_REGISTRY
+    arena_registry_report(stdout);
+#endif
+
+#ifdef ENABLE_MEM_LATENCY
+    mem_latency_report(stdout);
 #endif
 
     /* When main returns, the cleanup attribute automatically calls arena_destroy
-       on both arena and sec_arena (if defined), releasing all memory in one go. */
+       on both arena and sec_arena, releasing all memory in one go. */
     return 0;
 }
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include "h_memsuo.h"
+
+#define STR_EQ(a, b) (strcmp((a), (b)) == 0)
+
+VEC_DECLARE(IntVec, int);
+HMAP_DECLARE(U64Map, uint64_t, uint64_t, hmap_hash_u64, HMAP_EQ)
+HMAP_DECLARE(StrMap, const char *, int, hmap_hash_str, STR_EQ)
+
+#define MAP_KEYS 100000
+
+/* Inserts, looks up, erases half and reinserts; returns the number of mismatches. */
+static int exercise_map(ContainerHeap *heap)
+{
+    U64Map map;
+    U64Map_init(&map, heap);
+    int errors = 0;
+    for (uint64_t k = 0; k < MAP_KEYS; k++)
+    {
+        int inserted;
+        uint64_t *v = U64Map_insert(&map, k * 7919, &inserted);
+        if (!v || !inserted || *v != 0)
+            errors++;
+        else
+            *v = k;
+    }
+    for (uint64_t k = 0; k < MAP_KEYS; k++)
+    {
+        uint64_t *v = U64Map_find(&map, k * 7919);
+        if (!v || *v != k)
+            errors++;
+    }
+    if (U64Map_find(&map, 1) != NULL)
+        errors++;
+    for (uint64_t k = 0; k < MAP_KEYS; k += 2)
+        errors += U64Map_erase(&map, k * 7919) != 0;
+    for (uint64_t k = 0; k < MAP_KEYS; k++)
+    {
+        uint64_t *v = U64Map_find(&map, k * 7919);
+        if ((k % 2 == 0) != (v == NULL))
+            errors++;
+    }
+    /* Reinserting into deleted slots must not grow the table past its size. */
+    size_t cap = map.map.cap;
+    for (uint64_t k = 0; k < MAP_KEYS; k += 2)
+        *U64Map_insert(&map, k * 7919, NULL) = k;
+    size_t seen = 0;
+    size_t iter = 0;
+    for (U64MapEntry *e = U64Map_next(&map, &iter); e; e = U64Map_next(&map, &iter))
+    {
+        if (e->key != e->value * 7919)
+            errors++;
+        seen++;
+    }
+    if (seen != MAP_KEYS || U64Map_size(&map) != MAP_KEYS || map.map.cap != cap)
+        errors++;
+    U64Map_release(&map);
+    return errors;
+}
+
+int main(void)
+{
+    ARENA_SCOPE(arena, 64 * 1024);
+    ContainerHeap heap;
+    container_heap_init(&heap, &arena);
+
+    /* A vector whose buffer is the arena's latest allocation grows in place. */
+    IntVec v;
+    VEC_INIT(&v, &heap);
+    for (int i = 0; i < 8; i++)
+        VEC_PUSH(&v, i);
+    int *before = v.data;
+    for (int i = 8; i < 1000; i++)
+        VEC_PUSH(&v, i);
+    printf("Vector grew in place: %s, len %zu, [999] = %d\n", v.data == before ? "yes" : "no", v.len,
+           VEC_AT(&v, 999));
+    printf("Vector pop: %d\n", VEC_POP(&v));
+
+    /* Once something else is allocated after it, a vector has to move to grow;
+       its outgrown storage goes back to the heap and serves the next one. */
+    IntVec w;
+    VEC_INIT(&w, &heap);
+    VEC_PUSH(&w, 1);
+    int *first = w.data;
+    ARENA_ALLOC(&arena, char, 1);
+    VEC_RESERVE(&w, 4096);
+    IntVec x;
+    VEC_INIT(&x, &heap);
+    VEC_PUSH(&x, 2);
+    printf("Outgrown buffer reused: %s\n", x.data == first ? "yes" : "no");
+    VEC_RELEASE(&v);
+    VEC_RELEASE(&w);
+    VEC_RELEASE(&x);
+
+    int errors = exercise_map(&heap);
+    printf("Arena-backed map: %s\n", errors == 0 ? "ok" : "FAILED");
+    ContainerHeap sys;
+    container_heap_init(&sys, NULL);
+    errors = exercise_map(&sys);
+    printf("malloc-backed map: %s\n", errors == 0 ? "ok" : "FAILED");
+
+    /* The released table is recycled by the next map of the same size. */
+    ArenaStats st;
+    arena_stats(&arena, &st);
+    size_t used = st.used;
+    errors = exercise_map(&heap);
+    arena_stats(&arena, &st);
+    printf("Second map reused storage: %s\n", errors == 0 && st.used == used ? "yes" : "no");
+
+    StrMap words;
+    StrMap_init(&words, &heap);
+    const char *text[] = {"get", "post", "get", "put", "get", "post"};
+    for (size_t i = 0; i < sizeof(text) / sizeof(text[0]); i++)
+        (*StrMap_insert(&words, text[i], NULL))++;
+    printf("String map: get=%d post=%d put=%d size=%zu\n", *StrMap_find(&words, "get"), *StrMap_find(&words, "post"),
+           *StrMap_find(&words, "put"), StrMap_size(&words));
+
+    /* Nothing to free: arena_destroy at scope exit drops every container. */
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h>
+#include "i_memsuo.h"
+
+#define REQUESTS 10000
+
+int main(void)
+{
+    ARENA_SCOPE(arena, 4096);
+    Interner names;
+    interner_init(&names, &arena);
+
+    /* A parser sees the same header names on every request; interning keeps
+       one copy of each and turns the comparison into a pointer compare. */
+    static const char *const headers[] = {"Host", "User-Agent", "Accept", "Content-Type", "Content-Length",
+                                          "Connection"};
+    const size_t nheaders = sizeof(headers) / sizeof(headers[0]);
+    const char *content_type = intern_cstr(&names, "Content-Type");
+    size_t matches = 0;
+    for (int r = 0; r < REQUESTS; r++)
+    {
+        for (size_t h = 0; h < nheaders; h++)
+        {
+            char line[64];
+            size_t n = strlen(headers[h]);
+            memcpy(line, headers[h], n);
+            line[n] = ':';
+            const char *name = intern(&names, line, n);
+            if (INTERN_EQ(name, content_type))
+                matches++;
+        }
+    }
+    printf("Distinct names: %zu, pointer matches: %zu\n", interner_count(&names), matches);
+    printf("Bytes stored: %zu, copies avoided: %zu (%zu bytes)\n", names.bytes, names.hits, names.hit_bytes);
+
+    const char *host = interner_find(&names, "Host", 4);
+    printf("Lookup without insert: %s\n", host && strcmp(host, "Host") == 0 ? "found" : "missing");
+    printf("Unknown name: %s\n", interner_find(&names, "X-Trace", 7) ? "found" : "missing");
+    printf("Length and hash stored: %s\n",
+           intern_len(content_type) == 12 && intern_hash(content_type) == hmap_hash_bytes("Content-Type", 12) ? "yes"
+                                                                                                                : "no");
+
+    /* Strings are byte ranges: embedded NULs and prefixes stay distinct. */
+    const char *ab = intern(&names, "a\0b", 3);
+    const char *a = intern(&names, "a", 1);
+    printf("Embedded NUL distinct: %s\n", ab != a && intern_len(ab) == 3 && a[1] == '\0' ? "yes" : "no");
+
+    /* Many distinct keys force the table to grow; earlier pointers stay valid. */
+    char key[32];
+    for (int i = 0; i < 50000; i++)
+    {
+        int n = snprintf(key, sizeof(key), "key-%d", i);
+        intern(&names, key, (size_t)n);
+    }
+    int n = snprintf(key, sizeof(key), "key-%d", 4242);
+    const char *again = intern(&names, key, (size_t)n);
+    printf("Stable after growth: %s, count %zu\n",
+           again == interner_find(&names, "key-4242", 8) && intern_cstr(&names, "Content-Type") == content_type ? "yes"
+                                                                                                                 : "no",
+           interner_count(&names));
+    return 0;
+}
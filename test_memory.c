@@ -1,14 +1,9 @@
+#define MEMSTAT_FREE_BYTES
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
 #include "m_memsuo.h"
 
-#ifdef ENABLE_MEM_STATS
-_Atomic size_t g_total_alloc_bytes = 0;
-_Atomic size_t g_alloc_count = 0;
-_Atomic size_t g_free_count = 0;
-#endif
-
 #define THREAD_COUNT 4
 #define THREAD_ITERATIONS 1000
 
@@ -118,6 +113,52 @@ int main(void)
         }
     }
 
+    /* Extended API: aligned and zeroed in one call, grown in place when the
+       size class allows, then freed with the size the caller knows. */
+    unsigned char *xbuf = (unsigned char *)MALLOCX(200, MALLOCX_ALIGN(64) | MALLOCX_ZERO);
+    if (!xbuf)
+    {
+        LOG_ERROR("%s", "MALLOCX returned NULL");
+    }
+    else
+    {
+        if (!IS_ALIGNED(xbuf, 64) || xbuf[0] != 0 || xbuf[199] != 0)
+            LOG_ERROR("%s", "MALLOCX ignored the alignment or zero flag");
+#ifdef ENABLE_MEM_STATS
+        MemStatsSnapshot before_x, after_x;
+        mem_stats_snapshot(&before_x);
+#endif
+        size_t usable = XALLOCX(xbuf, 200, 0, MALLOCX_ALIGN(64));
+#ifdef ENABLE_MEM_STATS
+        /* Resizing in place is not a new allocation: only the bytes may move. */
+        mem_stats_snapshot(&after_x);
+        if (after_x.alloc_count != before_x.alloc_count || after_x.free_count != before_x.free_count)
+            LOG_ERROR("%s", "XALLOCX counted an in-place resize as an allocation");
+#endif
+        printf("MALLOCX: aligned, zeroed, usable %zu (nallocx %zu)\n", usable, NALLOCX(200, MALLOCX_ALIGN(64)));
+        memset(xbuf, 0xab, 200);
+        xbuf = (unsigned char *)RALLOCX(xbuf, 4096, MALLOCX_ALIGN(64) | MALLOCX_ZERO);
+        if (!xbuf || !IS_ALIGNED(xbuf, 64) || xbuf[199] != 0xab || xbuf[4095] != 0)
+            LOG_ERROR("%s", "RALLOCX lost data, alignment or the zeroed tail");
+        SDALLOCX(xbuf, 4096, MALLOCX_ALIGN(64));
+    }
+    int *sized = MALLOC_ARRAY(100, int);
+    SIZED_FREE(sized, 100 * sizeof(int));
+
+    unsigned je_arena;
+    if (mem_je_arena_create(&je_arena) == 0)
+    {
+        void *routed = MALLOCX(1024, MALLOCX_ARENA(je_arena) | MALLOCX_TCACHE_NONE);
+        SDALLOCX(routed, 1024, MALLOCX_TCACHE_NONE);
+        mem_je_thread_tcache_flush();
+        mem_je_arena_destroy(je_arena);
+        printf("Dedicated jemalloc arena %u created and destroyed.\n", je_arena);
+    }
+    else
+    {
+        printf("Dedicated jemalloc arenas not available.\n");
+    }
+
 #ifdef USE_SODIUM
     char *secure_msg = (char *)SODIUM_MALLOC(64);
     if (!secure_msg)
@@ -152,10 +193,55 @@ int main(void)
     FREE(aligned_ptr);
 
 #ifdef ENABLE_MEM_STATS
-    printf("Memory stats:\n");
-    printf("  Total allocated bytes: %zu\n", ATOMIC_LOAD(g_total_alloc_bytes));
-    printf("  Allocation count: %zu\n", ATOMIC_LOAD(g_alloc_count));
-    printf("  Free count: %zu\n", ATOMIC_LOAD(g_free_count));
+    mem_stats_print(stdout);
+
+    /* Everything above has been freed, so live bytes must be back to zero
+       even though allocations and frees were spread across threads. */
+    MemStatsSnapshot snap;
+    mem_stats_snapshot(&snap);
+    if (snap.live_bytes != 0)
+        LOG_ERROR("live bytes not zero after all frees: %lld", (long long)snap.live_bytes);
+    if (snap.alloc_bytes - snap.free_bytes != (size_t)snap.live_bytes)
+        LOG_ERROR("%s", "live bytes disagree with allocated minus freed");
+
+    /* The pre-sharding counters still read, now summed from the shards. */
+    if (ATOMIC_LOAD(g_alloc_count) != snap.alloc_count || g_total_alloc_bytes != snap.alloc_bytes)
+        LOG_ERROR("%s", "legacy counters disagree with the snapshot");
+#endif
+
+#ifdef ENABLE_MEM_PROFILE
+    /* Sample every ~4 KiB so this small run records something, leak one
+       site on purpose, and show it ranked first by live bytes. */
+    mem_profile_set_rate(4096);
+    void *leaks[64];
+    for (int i = 0; i < 64; i++)
+        leaks[i] = MALLOC(16 * 1024);
+    for (int i = 0; i < 1000; i++)
+    {
+        void *tmp = MALLOC(512);
+        FREE(tmp);
+    }
+    mem_profile_dump(stdout, 5);
+    for (int i = 0; i < 64; i++)
+        FREE(leaks[i]);
+    if (g_mem_profile.live_count != 0)
+        LOG_ERROR("%s", "profiler still holds samples after every allocation was freed");
+#endif
+
+#ifdef ENABLE_MEM_LATENCY
+    /* Every MALLOC above, including the worker threads', was timed. */
+    mem_latency_report(stdout);
+    MemLatencyStats lat;
+    mem_latency_query(MEMLAT_MALLOC, &lat);
+    if (lat.count == 0 || lat.p50_ns > lat.p99_ns || lat.p99_ns > lat.max_ns)
+        LOG_ERROR("%s", "MALLOC latency percentiles are inconsistent");
+
+    /* Stalls past the top exponent land in the last bucket of their own op. */
+    memlat_record(MEMLAT_ARENA_GROW, 1ull << MEMLAT_MAX_EXPONENT);
+    memlat_record(MEMLAT_ARENA_GROW, UINT64_MAX);
+    mem_latency_query(MEMLAT_ARENA_GROW, &lat);
+    if (lat.count != 2 || lat.p50_ns <= 0 || lat.p50_ns > lat.max_ns)
+        LOG_ERROR("%s", "out-of-range latencies were not clamped to the last bucket");
 #endif
 
     printf("All tests completed successfully.\n");
@@ -0,0 +1,89 @@
+#define MEMSTAT_FREE_BYTES
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "r_memsuo.hpp"
+
+struct alignas(64) CacheLine
+{
+    char bytes[64];
+};
+
+int main()
+{
+    /* pmr containers on a wrapped arena: every byte they use comes from it. */
+    {
+        ARENA_SCOPE(arena, 4096);
+        memsuo::ArenaResource resource(&arena);
+        std::pmr::vector<int> numbers(&resource);
+        for (int i = 0; i < 1000; i++)
+            numbers.push_back(i * 3);
+        std::pmr::unordered_map<int, std::pmr::string> names(&resource);
+        for (int i = 0; i < 100; i++)
+            names[i] = std::pmr::string("a name long enough to skip the small string buffer ") + std::to_string(i).c_str();
+        const char *first = reinterpret_cast<const char *>(numbers.data());
+        bool inside = false;
+        for (ArenaBlock *b = arena.blocks; b; b = b->next)
+            inside |= first >= reinterpret_cast<const char *>(b->base) &&
+                      first < reinterpret_cast<const char *>(b->base) + b->capacity;
+        ArenaStats st;
+        arena_stats(&arena, &st);
+        std::printf("Arena resource: numbers[999] = %d, names[42] = %s\n", numbers[999], names[42].c_str());
+        std::printf("Storage in arena: %s, used %zu bytes in %zu blocks\n", inside ? "yes" : "no", st.used, st.blocks);
+
+        /* Over-aligned requests honour their alignment. */
+        std::pmr::vector<CacheLine> lines(8, &resource);
+        std::printf("Arena alignment honoured: %s\n",
+                    reinterpret_cast<uintptr_t>(lines.data()) % 64 == 0 ? "yes" : "no");
+
+        std::printf("Resources compare by identity: %s\n",
+                    resource.is_equal(resource) && !resource.is_equal(*memsuo::malloc_resource()) ? "yes" : "no");
+    }
+
+    /* An owning resource resets its arena on release and frees it when destroyed. */
+    {
+        memsuo::ArenaResource owned(1024);
+        void *before = owned.allocate(16);
+        owned.release();
+        void *after = owned.allocate(16);
+        std::printf("Release rewinds the arena: %s\n", before == after ? "yes" : "no");
+        std::pmr::list<std::pmr::string> words(&owned);
+        words.emplace_back("monotonic");
+        std::printf("Owned arena list: %s\n", words.back().c_str());
+    }
+
+    /* The MALLOCX-backed resource and allocator free with the size they allocated. */
+    {
+        std::pmr::vector<long> longs(memsuo::malloc_resource());
+        for (long i = 0; i < 10000; i++)
+            longs.push_back(i);
+        std::pmr::vector<CacheLine> aligned(4, memsuo::malloc_resource());
+        std::printf("Malloc resource: longs[9999] = %ld, aligned: %s\n", longs[9999],
+                    reinterpret_cast<uintptr_t>(aligned.data()) % 64 == 0 ? "yes" : "no");
+
+        std::vector<std::string, memsuo::MallocAllocator<std::string>> strings;
+        for (int i = 0; i < 100; i++)
+            strings.emplace_back(64, static_cast<char>('a' + i % 26));
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                           memsuo::MallocAllocator<std::pair<const int, int>>>
+            squares;
+        for (int i = 0; i < 1000; i++)
+            squares[i] = i * i;
+        std::printf("MallocAllocator: strings[27][0] = %c, squares[999] = %d, stateless: %s\n", strings[27][0],
+                    squares[999],
+                    memsuo::MallocAllocator<int>() == memsuo::MallocAllocator<long>() ? "yes" : "no");
+    }
+
+#ifdef ENABLE_MEM_STATS
+    MemStatsSnapshot snap;
+    mem_stats_snapshot(&snap);
+    std::printf("Live bytes after containers freed: %lld\n", (long long)snap.live_bytes);
+    std::printf("Legacy counters match: %s\n",
+                g_alloc_count.load() == snap.alloc_count && g_free_count == snap.free_count ? "yes" : "no");
+#endif
+    return 0;
+}
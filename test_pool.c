@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "p_memsuo.h"
+
+typedef struct
+{
+    int fd;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    char peer[46];
+} Connection;
+
+int main(void)
+{
+    /* Declare a pool of Connection slots that is destroyed at scope exit. */
+    POOL_SCOPE(pool, Connection);
+
+    Connection *conns[100];
+    for (int i = 0; i < 100; i++)
+    {
+        conns[i] = POOL_ALLOC(&pool);
+        if (!conns[i])
+        {
+            fprintf(stderr, "Pool allocation failed\n");
+            return 1;
+        }
+        conns[i]->fd = i;
+    }
+
+    /* Slots are carved back to back from the arena. */
+    printf("Pool slot size: %zu, adjacent slots contiguous: %s\n", pool.slot_size,
+           (char *)conns[1] - (char *)conns[0] == (ptrdiff_t)pool.slot_size ? "yes" : "no");
+
+    /* Freed slots are reused most-recently-freed first and come back zeroed. */
+    POOL_FREE(&pool, conns[10]);
+    POOL_FREE(&pool, conns[20]);
+    Connection *a = POOL_ALLOC(&pool);
+    Connection *b = POOL_ALLOC(&pool);
+    printf("Pool reuses freed slots: %s\n", (a == conns[20] && b == conns[10]) ? "yes" : "no");
+    printf("Reused slot zeroed: %s\n", (a->fd == 0 && b->fd == 0) ? "yes" : "no");
+
+    /* Churn: free and reallocate repeatedly without growing the arena. */
+    ArenaBlock *current = pool.arena.current;
+    for (int round = 0; round < 1000; round++)
+    {
+        for (int i = 0; i < 100; i += 3)
+            POOL_FREE(&pool, conns[i]);
+        for (int i = 0; i < 100; i += 3)
+            conns[i] = POOL_ALLOC_NOZERO(&pool);
+    }
+    printf("Churn stayed within existing blocks: %s\n", pool.arena.current == current ? "yes" : "no");
+
+    POOL_FREE(&pool, NULL);
+
+    /* Variable-sized objects share an arena through per-size-class free
+       lists; a freed node is reused by the next request in the same class. */
+    ARENA_SCOPE(tree_arena, 4096);
+    SizeClassAlloc sc;
+    sizeclass_init(&sc, &tree_arena);
+    int mismatches = 0;
+    for (size_t size = 1; size <= SIZECLASS_MAX; size++)
+    {
+        size_t index = sizeclass_index(size);
+        if (sizeclass_size(index) < size || (index > 0 && sizeclass_size(index - 1) >= size))
+            mismatches++;
+    }
+    printf("Size classes: %d, largest %zu, mapping errors: %d\n", SIZECLASS_COUNT,
+           sizeclass_size(SIZECLASS_COUNT - 1), mismatches);
+
+    char *node = SIZECLASS_ALLOC(&sc, char, 100);
+    SIZECLASS_FREE(&sc, node, char, 100);
+    char *same_class = SIZECLASS_ALLOC(&sc, char, 112);
+    char *other_class = SIZECLASS_ALLOC(&sc, char, 200);
+    printf("Size-class reuse within class: %s, across classes: %s\n", same_class == node ? "yes" : "no",
+           other_class == node ? "yes" : "no");
+    printf("Overflowing count refused: %s\n", SIZECLASS_ALLOC(&sc, long, SIZE_MAX / 4) == NULL ? "yes" : "no");
+
+    /* arena_destroy at scope exit releases every object at once. */
+    return 0;
+}
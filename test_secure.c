@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "s_memsuo.h"
+
+typedef struct
+{
+    unsigned char key[32];
+} SessionKey;
+
+int main(void)
+{
+    /* A thousand 32-byte keys share a couple of regions instead of taking
+       two guard pages and an mlock each. */
+    SessionKey *keys[1000];
+    for (int i = 0; i < 1000; i++)
+    {
+        keys[i] = SECURE_ALLOC(SessionKey, 1);
+        if (!keys[i])
+        {
+            fprintf(stderr, "Secure allocation failed\n");
+            return 1;
+        }
+        memset(keys[i]->key, i & 0xff, sizeof(keys[i]->key));
+    }
+    printf("Keys allocated: 1000, mapped bytes: %zu\n", __secure_slab_default.mapped_bytes);
+    printf("Slots 16-byte aligned: %s\n", ((uintptr_t)keys[1] & 15) == 0 ? "yes" : "no");
+
+    /* A freed slot is wiped and handed out again already zeroed. */
+    unsigned char *old = keys[500]->key;
+    SECURE_FREE(keys[500]);
+    keys[500] = SECURE_ALLOC(SessionKey, 1);
+    int zeroed = 1;
+    for (size_t i = 0; i < sizeof(keys[500]->key); i++)
+        zeroed &= keys[500]->key[i] == 0;
+    printf("Freed slot reused: %s, zeroed: %s\n", keys[500]->key == old ? "yes" : "no", zeroed ? "yes" : "no");
+
+    /* Buffers of a few KiB, like a secure arena's blocks, share slab regions
+       instead of mapping one each. */
+    size_t before = __secure_slab_default.mapped_bytes;
+    unsigned char *buffers[3];
+    for (int i = 0; i < 3; i++)
+        buffers[i] = SECURE_ALLOC(unsigned char, 8000);
+    printf("8000-byte buffers share a region: %s\n",
+           buffers[2] && __secure_slab_default.mapped_bytes - before == SECURE_SLAB_REGION ? "yes" : "no");
+    for (int i = 0; i < 3; i++)
+        SECURE_FREE(buffers[i]);
+
+    /* Large secrets get a dedicated guarded region. */
+    unsigned char *big = SECURE_ALLOC(unsigned char, 100000);
+    big[99999] = 1;
+    SECURE_FREE(big);
+
+    for (int i = 0; i < 1000; i++)
+        SECURE_FREE(keys[i]);
+    printf("Mapped bytes after free: %zu\n", __secure_slab_default.mapped_bytes);
+
+    /* A separately owned slab can be torn down in one go. */
+    SecureSlab slab;
+    secure_slab_init(&slab);
+    void *k = secure_slab_alloc(&slab, 48);
+    printf("Private slab allocation: %s\n", k ? "ok" : "failed");
+    secure_slab_free(k);
+    secure_slab_destroy(&slab);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "t_memsuo.h"
+
+#define THREAD_COUNT 4
+#define TASKS_PER_THREAD 1000
+
+/* One unit of work from a pooled worker: it borrows the thread's arena,
+   allocates freely, and hands everything back when the scope closes. */
+static int run_task(int task)
+{
+    ARENA_SCOPE_TLS(scratch);
+    int *values = ARENA_ALLOC(scratch, int, 256);
+    if (!values)
+        return -1;
+    for (int i = 0; i < 256; i++)
+        values[i] = task + i;
+
+    {
+        /* Nested scopes rewind to where the outer scope left off. */
+        ARENA_SCOPE_TLS(inner);
+        char *buf = ARENA_ALLOC(inner, char, 128 * 1024);
+        if (!buf)
+            return -1;
+        snprintf(buf, 64, "task %d", task);
+    }
+    return values[255] - 255 == task ? 0 : -1;
+}
+
+static void *worker(void *arg)
+{
+    int *failures = (int *)arg;
+    ArenaBlock *warm = NULL;
+    for (int t = 0; t < TASKS_PER_THREAD; t++)
+    {
+        if (run_task(t) != 0)
+            (*failures)++;
+        if (t == 0)
+            warm = g_arena_tls.arena.blocks;
+        else if (g_arena_tls.arena.blocks != warm)
+            (*failures)++;
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[THREAD_COUNT];
+    int failures[THREAD_COUNT] = {0};
+
+    for (int i = 0; i < THREAD_COUNT; i++)
+    {
+        if (pthread_create(&threads[i], NULL, worker, &failures[i]) != 0)
+        {
+            fprintf(stderr, "Failed to create thread\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < THREAD_COUNT; i++)
+        pthread_join(threads[i], NULL);
+
+    int total_failures = 0;
+    for (int i = 0; i < THREAD_COUNT; i++)
+        total_failures += failures[i];
+    printf("Thread-local arena tasks: %d threads x %d tasks, %d failures\n", THREAD_COUNT, TASKS_PER_THREAD,
+           total_failures);
+    printf("Blocks returned to the global pool by exited threads: %zu bytes\n", g_arena_tls_pool.cached_bytes);
+
+    /* A new thread starts from the pooled blocks instead of malloc. */
+    size_t before = g_arena_tls_pool.cached_bytes;
+    run_task(0);
+    printf("Main thread adopted pooled blocks: %s\n", g_arena_tls_pool.cached_bytes < before ? "yes" : "no");
+
+    arena_tls_release();
+    arena_tls_pool_trim();
+    printf("Pool after trim: %zu bytes\n", g_arena_tls_pool.cached_bytes);
+
+    /* A thread that exits mid-scope pools its current block as it stands;
+       whatever it wrote there must be zeroed for the next borrower. */
+    {
+        ArenaScratch open = arena_tls_begin();
+        memset(ARENA_ALLOC_NOZERO(open.arena, char, 256 * 1024), 0xab, 256 * 1024);
+        arena_tls_release();
+    }
+    {
+        ARENA_SCOPE_TLS(reused);
+        unsigned char *bytes = ARENA_ALLOC(reused, unsigned char, 256 * 1024);
+        size_t dirty = 0;
+        for (size_t i = 0; bytes && i < 256 * 1024; i++)
+            dirty += bytes[i] != 0;
+        printf("Pooled current block rezeroed: %s\n", bytes && dirty == 0 ? "yes" : "no");
+        if (!bytes || dirty)
+            total_failures++;
+    }
+    arena_tls_release();
+    arena_tls_pool_trim();
+    return total_failures ? 1 : 0;
+}